@@ -0,0 +1,68 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
+const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+// Texture units the cluster buffers stay bound to; nothing else uses them.
+const int CLUSTER_OFFSETS_UNIT = 2;
+const int CLUSTER_INDICES_UNIT = 3;
+const int CLUSTER_LIGHTS_UNIT = 4;
+
+struct PointLight {
+    glm::vec3 position;
+    float radius;           // light reaches zero at this distance
+    glm::vec3 color;        // premultiplied by intensity
+};
+
+// Mirrors the std140 ClusterData block in basic.frag.
+struct ClusterData {
+    glm::vec4 grid;         // tiles x, tiles y, slices, light count
+    glm::vec4 depth;        // near, slice scale, slice bias, far
+    glm::vec4 tileSize;     // pixels per tile x, y
+};
+static_assert(sizeof(ClusterData) == 48, "ClusterData must match the std140 block layout");
+
+// Clustered forward lighting. Every frame the point lights are binned on the
+// CPU into view-space froxels (screen tiles x exponential depth slices), and
+// basic.frag loops over only the lights listed for its own cluster. The grid
+// (offset, count per cluster), the flat light index list and the light data
+// are texture buffers; the grid parameters are a uniform block.
+class ClusteredLighting {
+public:
+    ClusteredLighting();
+
+    void create();
+    void destroy();
+
+    // Bins the lights on the CPU; no GL calls, so it can run on a job thread.
+    void build(const std::vector<PointLight>& lights, const glm::mat4& view, float fovY, float aspect,
+               float zNear, float zFar, int viewportWidth, int viewportHeight);
+    // Uploads what the last build produced. Context thread only.
+    void upload();
+    // Binds the three buffer textures to their units.
+    void bind() const;
+
+    int getLightCount() const { return lightCount; }
+    int getLightReferences() const { return (int)indices.size(); }
+
+private:
+    void uploadBuffer(GLuint buffer, const void* data, size_t bytes);
+
+    GLuint offsetsBuffer, indicesBuffer, lightsBuffer;
+    GLuint offsetsTexture, indicesTexture, lightsTexture;
+    GLuint uniformBuffer;
+
+    std::vector<uint32_t> offsets;          // offset, count per cluster
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec4> lightData;       // position/radius, colour per light
+    std::vector<int> lightRanges;           // x0, x1, y0, y1, z0, z1 per light
+    int lightCount;
+    ClusterData clusterData;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+
+struct DynamicResolutionSettings {
+    float targetMs;     // GPU frame time the scale is adjusted to stay under
+    float minScale;     // bounds of the render scale, per axis
+    float maxScale;
+};
+
+// Renders the 3D scene into an offscreen target the window's size times a
+// scale and stretches it over the window with a linear blit; whatever is
+// drawn after resolve() (the overlays) stays at native resolution.
+// The scale follows the measured GPU frame time. GPU time is taken to grow
+// with the pixel count, so scale * sqrt(target / measured) is the scale that
+// would just meet the target. Over the target the scale drops there at once;
+// it only climbs again, one step at a time, while the step still leaves
+// headroom. Samples from before a change are discarded, since the timer
+// queries come back a few frames late.
+// The target is allocated for the largest scale, so changing the scale only
+// changes the viewport and the blit's source rectangle.
+class DynamicResolution {
+public:
+    DynamicResolution();
+
+    void create(const DynamicResolutionSettings& settings);
+    void destroy();
+
+    // Feeds one resolved GPU frame time; may change the scale.
+    void update(double gpuMs, double now);
+    // Picks this frame's render size, width and height, for the window; when
+    // disabled that is the window. Comes before begin, so the scene can be
+    // prepared for that size before anything is drawn.
+    void prepare(int windowWidth, int windowHeight, int& width, int& height);
+    // Binds the framebuffer the scene renders into and sets its viewport.
+    void begin();
+    // Upscales the scene to the window and leaves the window bound.
+    void resolve();
+    // Prints the scale changes since the previous report.
+    void report(double now);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+    float getScale() const { return enabled ? scale : 1.0f; }
+    const DynamicResolutionSettings& getSettings() const { return settings; }
+
+private:
+    struct ScaleChange {
+        double time;
+        float scale;
+        float gpuMs;
+    };
+
+    void allocate(int windowWidth, int windowHeight);
+
+    DynamicResolutionSettings settings;
+    GLuint fbo, colorBuffer, depthBuffer;
+    int targetWidth, targetHeight;      // allocated size, at maxScale
+    int windowWidth, windowHeight;
+    int renderWidth, renderHeight;
+    bool enabled;
+    float scale;
+    double smoothedMs;
+    int samplesSinceChange;
+    std::vector<ScaleChange> history;
+    float reportStartScale;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Frames whose dynamic data can be in flight on the GPU at once.
+const int RING_FRAMES = 3;
+
+struct RingAllocation {
+    void* data;         // where to write; nullptr when the frame's space ran out
+    size_t offset;      // byte offset into the ring's buffer
+};
+
+// One GL buffer that every frame's dynamic data (instances, streamed vertices,
+// per-frame uniforms) is written into. VAOs and uniform bindings point at it
+// once; draws pick their data by first vertex, base instance or bound range.
+// With ARB_buffer_storage the buffer is persistently mapped with coherent
+// writes and split into RING_FRAMES regions, one per frame. A fence guards
+// each region, so by the time a region comes round again the GPU has almost
+// always finished with it and the CPU writes straight in without waiting.
+// On plain GL 3.3 allocations are staged in memory and flush() orphans the
+// buffer and uploads everything written so far this frame.
+class FrameRingBuffer {
+public:
+    FrameRingBuffer();
+
+    void create(size_t frameBytes);
+    void destroy();
+
+    void beginFrame();
+    // The offset is rounded up to a multiple of alignment, which need not be a
+    // power of two, so an element size turns it into a first vertex or instance.
+    RingAllocation allocate(size_t bytes, size_t alignment);
+    // Makes what was written so far visible to draws issued after it. Without
+    // persistent mapping every call uploads the whole frame again, so call it
+    // once, after the frame's last allocation.
+    void flush();
+    void endFrame();
+
+    GLuint id() const { return buffer; }
+    bool isPersistent() const { return persistent; }
+    size_t getUniformAlignment() const { return uniformAlignment; }
+
+private:
+    GLuint buffer;
+    size_t frameBytes;
+    size_t uniformAlignment;
+    bool persistent;
+    unsigned char* mapped;
+    std::vector<unsigned char> staging;
+    GLsync fences[RING_FRAMES];
+    int region;
+    size_t used;
+    size_t flushed;
+    bool overflowReported;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "glm/glm.hpp"
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Bounds of a box after an affine transform (Arvo's method): the result encloses
+// all eight transformed corners without transforming them one by one.
+AABB transformAABB(const AABB& box, const glm::mat4& model);
+
+// The six clip planes of a view-projection matrix, stored plane-major in groups
+// of four so one SSE pass tests a box against four planes at once. The two
+// padding planes always pass.
+class Frustum {
+public:
+    void extract(const glm::mat4& viewProjection);
+    bool isVisible(const AABB& box) const;
+
+private:
+    static const int PLANE_SLOTS = 8;
+
+    alignas(16) float nx[PLANE_SLOTS];
+    alignas(16) float ny[PLANE_SLOTS];
+    alignas(16) float nz[PLANE_SLOTS];
+    alignas(16) float d[PLANE_SLOTS];
+};
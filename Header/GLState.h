@@ -0,0 +1,52 @@
+#pragma once
+#include <GL/glew.h>
+
+const int GL_STATE_TEXTURE_UNITS = 8;
+const int GL_STATE_TEXTURE_TARGETS = 3;   // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER
+
+// Shadow copy of the GL binding and enable state the renderer touches. Calls
+// that would set a value already in effect are dropped and counted in
+// PROF_GL_CALLS_ELIDED. With validation on, every call first compares the
+// shadow against glGet and reports any drift (state changed behind the cache).
+class GLStateCache {
+public:
+    GLStateCache();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindTexture(int unit, GLuint texture, GLenum target = GL_TEXTURE_2D);
+    void setEnabled(GLenum cap, bool enabled);
+    void blendFunc(GLenum src, GLenum dst);
+
+    // Drop bindings to objects that are about to be deleted, since GL resets
+    // those bindings to 0 on deletion.
+    void forgetTexture(GLuint texture);
+    void forgetVertexArray(GLuint vao);
+
+    // Forget everything; the next call of each kind always reaches GL.
+    void invalidate();
+
+    void setValidation(bool enabled) { validation = enabled; }
+    bool isValidating() const { return validation; }
+
+private:
+    enum CapIndex { CAP_CULL_FACE, CAP_DEPTH_TEST, CAP_BLEND, CAP_COUNT };
+
+    int capIndex(GLenum cap) const;
+    int targetIndex(GLenum target) const;
+    void activeTexture(int unit);
+    void reportMismatch(const char* what, long long shadow, long long actual);
+
+    GLuint program;
+    GLuint vao;
+    GLuint textures[GL_STATE_TEXTURE_TARGETS][GL_STATE_TEXTURE_UNITS];
+    int activeUnit;
+    int caps[CAP_COUNT];
+    GLenum blendSrc, blendDst;
+
+    bool programKnown, vaoKnown, blendKnown;
+    bool texturesKnown[GL_STATE_TEXTURE_TARGETS][GL_STATE_TEXTURE_UNITS];
+    bool validation;
+};
+
+extern GLStateCache glState;
@@ -0,0 +1,52 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+// Attribute location of the per-vertex colour read by basic.vert when
+// USE_VERTEX_COLOR is defined.
+const GLuint BATCH_COLOR_ATTRIB = 7;
+
+struct BatchVertex {
+    float position[3];
+    float normal[3];
+    float color[3];
+};
+
+// Points attributes 0, 1 and BATCH_COLOR_ATTRIB of a VAO at BatchVertex data
+// starting at the beginning of buffer.
+void attachBatchVertices(GLuint vao, GLuint buffer);
+
+struct BatchRange {
+    int first;
+    int count;
+};
+
+// Bakes transformed copies of small meshes into one vertex buffer with a colour
+// per vertex, so many constant objects can be drawn with a single call.
+// Meshes are given in the interleaved position/normal/texcoord layout used by
+// the cube and quad arrays.
+class GeometryBatch {
+public:
+    GeometryBatch();
+
+    void clear();
+    void addMesh(const float* vertices, int vertexCount, const glm::mat4& model, const glm::vec3& color);
+    int size() const { return (int)vertices.size(); }
+    const std::vector<BatchVertex>& getVertices() const { return vertices; }
+    // Splits triangles along their longest edge until no edge is longer than
+    // maxEdge, so per-vertex data has enough samples across large faces.
+    // Triangle order is kept and the given ranges are moved to match.
+    void subdivide(float maxEdge, const std::vector<BatchRange*>& ranges);
+
+    // Sends the baked vertices to the GPU for batches that own their buffer.
+    // Batches rebuilt at runtime can instead stream getVertices() themselves.
+    void upload(GLenum usage);
+    GLuint getVAO() const { return vao; }
+    void destroy();
+
+private:
+    std::vector<BatchVertex> vertices;
+    GLuint vao, vbo;
+};
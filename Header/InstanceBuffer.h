@@ -0,0 +1,54 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+// First vertex attribute location used by per-instance data; locations 0-2 are
+// the mesh position, normal and texture coordinate.
+const GLuint INSTANCE_ATTRIB_FIRST = 3;
+// The per-instance normal scale sits above the batch colour and mesh material.
+const GLuint INSTANCE_NORMAL_ATTRIB = 9;
+
+// Per-instance layout read by basic.vert when USE_INSTANCING is defined: the top
+// three rows of the model matrix (the last row is always 0,0,0,1), a colour and
+// a per-axis normal scale. For a rotate-scale matrix M, mat3(M) * (n / s^2) is
+// the inverse transpose applied to n, so the shader needs no inverse.
+struct InstanceData {
+    glm::vec4 modelRows[3];
+    glm::vec4 color;
+    glm::vec4 normalScale;
+};
+
+InstanceData makeInstanceData(const glm::mat4& model, const glm::vec3& color);
+
+// Inverse transpose of the model's upper 3x3, or the 3x3 itself when the scale
+// is uniform (normals are renormalized per fragment anyway).
+glm::mat3 normalMatrix(const glm::mat4& model);
+
+// Points the instance attributes of a mesh VAO at InstanceData in any buffer,
+// starting at firstInstance.
+void attachInstanceAttributes(GLuint vao, GLuint buffer, size_t firstInstance = 0);
+
+// A vertex buffer of InstanceData that can be attached to any mesh VAO.
+// Uploads only touch the requested range; the buffer grows when needed and keeps
+// its GL name, so VAOs it was attached to stay valid.
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+
+    void create(size_t capacity);
+    void destroy();
+
+    // firstInstance offsets the attribute pointers, standing in for a base
+    // instance on drivers without one.
+    void attach(GLuint vao, size_t firstInstance = 0) const;
+    void upload(const InstanceData* instances, size_t first, size_t count);
+
+    GLuint id() const { return buffer; }
+    size_t getCapacity() const { return capacity; }
+
+private:
+    GLuint buffer;
+    size_t capacity;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs run and waited on together. Only touched under the job system's lock.
+struct JobGroup {
+    int pending;
+
+    JobGroup() : pending(0) {}
+};
+
+// A pool of worker threads for the CPU half of a frame: culling, matrices,
+// instance data and sort keys. Jobs must not make GL calls or touch the
+// profiler counters; they write their results into memory the caller hands
+// out, and the context thread uploads and submits once they are done.
+// A waiting thread runs queued jobs itself instead of sleeping, so waiting
+// from inside a job is fine. Without workers every job runs inline.
+class JobSystem {
+public:
+    JobSystem();
+    ~JobSystem();
+
+    // threads <= 0 uses one less than the hardware threads, leaving one for
+    // the caller.
+    void start(int threads);
+    void shutdown();
+
+    void run(JobGroup& group, const std::function<void()>& job);
+    void wait(JobGroup& group);
+
+    // Calls job(begin, end) over [0, count) in chunks of at least minChunk
+    // items, spread over the workers and the caller; returns when all are done.
+    void parallelFor(int count, int minChunk, const std::function<void(int, int)>& job);
+
+    int getWorkerCount() const { return (int)workers.size(); }
+
+private:
+    struct Job {
+        std::function<void()> function;
+        JobGroup* group;
+    };
+
+    void workerLoop();
+    // Runs the front job with the lock released; expects a non-empty queue.
+    void runFront(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> workers;
+    std::deque<Job> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool quit;
+};
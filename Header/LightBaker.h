@@ -0,0 +1,50 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "GeometryBatch.h"
+
+// Attribute locations of the baked irradiance read by basic.vert when
+// USE_BAKED_LIGHTING is defined, one per baked light.
+const GLuint BAKED_LIGHT_ATTRIB_FIRST = 10;
+const int BAKED_LIGHT_COUNT = 2;
+
+struct BakeSettings {
+    int samples;            // cosine-weighted hemisphere rays per vertex
+    float aoDistance;       // occluders further away than this do not darken the ambient term
+    int threads;            // 0 uses every hardware thread
+};
+
+// Per-vertex irradiance for a static batch, path traced on the CPU.
+// Each light is baked as a unit white point light: one vec4 per vertex and
+// light holding ambient (with ambient occlusion) + direct (with visibility)
+// + one diffuse bounce in rgb, and the direct share of that in w so the
+// runtime can still darken it with the shadow map for moving casters.
+// Light colour scales the result linearly, so states that only differ in
+// colour share a bake. Results are cached on disk, keyed by a hash of the
+// scene, the settings, the bake's lighting constants and a bake version.
+class LightBaker {
+public:
+    LightBaker();
+
+    // receivers get baked values; both receivers and occluders block rays and
+    // reflect light with their vertex colour as albedo.
+    void bake(const std::vector<BatchVertex>& receivers, const std::vector<BatchVertex>& occluders,
+              const glm::vec3 lightPositions[BAKED_LIGHT_COUNT], const BakeSettings& settings);
+
+    // Uploads the baked values and points the attributes of a batch VAO at them.
+    void attach(GLuint vao);
+    void destroy();
+
+    const std::vector<glm::vec4>& getData() const { return data; }
+
+private:
+    bool readCache(const std::string& file, size_t vertexCount);
+    void writeCache(const std::string& file) const;
+
+    std::vector<glm::vec4> data;    // BAKED_LIGHT_COUNT values per receiver vertex
+    GLuint buffer;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Interleaved position/normal/texcoord plus a material (rgb diffuse colour, w =
+// texture array layer or -1), the layout used by imported models.
+const int MESH_VERTEX_FLOATS = 12;
+const GLuint MESH_MATERIAL_ATTRIB = 8;
+
+// Hands out [offset, offset + size) ranges from a linear space. Free ranges are
+// kept sorted and merged with their neighbours on release, and allocation picks
+// the smallest range that fits, so loading and unloading models does not
+// shred the space into unusable slivers.
+class RangeAllocator {
+public:
+    RangeAllocator();
+
+    void reset(uint32_t capacity);
+    bool allocate(uint32_t size, uint32_t& offset);
+    void release(uint32_t offset, uint32_t size);
+    // Extends the space; the new tail is merged into a trailing free range.
+    void grow(uint32_t newCapacity);
+
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getFreeTotal() const;
+    uint32_t getLargestFree() const;
+
+private:
+    std::map<uint32_t, uint32_t> freeRanges;   // offset -> size
+    uint32_t capacity;
+};
+
+struct MeshAllocation {
+    GLint baseVertex;       // added to every index by the *BaseVertex draws
+    GLuint firstIndex;
+    GLsizei indexCount;
+    GLsizei vertexCount;
+};
+
+// Turns a triangle list into unique vertices plus 32-bit indices.
+void indexMeshVertices(const std::vector<float>& triangles, std::vector<float>& vertices,
+                       std::vector<uint32_t>& indices);
+
+// One vertex buffer, one index buffer and one VAO shared by every imported
+// mesh. Meshes are sub-allocated; indices stay mesh-local and are drawn with
+// the allocation's baseVertex. Both buffers grow by copying on the GPU when a
+// mesh does not fit.
+class MeshBuffer {
+public:
+    MeshBuffer();
+
+    void create(uint32_t vertexCapacity, uint32_t indexCapacity);
+    void destroy();
+
+    bool add(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+             MeshAllocation& allocation);
+    void remove(const MeshAllocation& allocation);
+
+    GLuint getVAO() const { return vao; }
+    const RangeAllocator& getVertexRanges() const { return vertexRanges; }
+    const RangeAllocator& getIndexRanges() const { return indexRanges; }
+
+private:
+    void growVertices(uint32_t minCapacity);
+    void growIndices(uint32_t minCapacity);
+    void bindVertexAttributes();
+
+    GLuint vao, vbo, ibo;
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Frustum.h"
+
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 144;
+
+// Software occlusion culling against a small CPU depth buffer. Static occluder
+// triangles are rasterized on a worker thread while the main thread queues the
+// rest of the scene; boxes are then tested against the finished buffer.
+// Depth is NDC z, so smaller is closer and the buffer clears to 1.
+class OcclusionCuller {
+public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    // World-space triangles, three vertices each. Only call while idle.
+    void setOccluders(const std::vector<glm::vec3>& triangles);
+
+    void start();
+    void shutdown();
+
+    // Hands the frame's rasterization to the worker and returns immediately.
+    void beginFrame(const glm::mat4& viewProjection);
+    // Blocks until the depth buffer for the current frame is ready.
+    void finish();
+
+    // True only if every pixel the box covers is nearer than the box itself.
+    bool isOccluded(const AABB& box) const;
+
+    int getOccluderTriangles() const { return (int)occluders.size() / 3; }
+
+private:
+    void workerLoop();
+    void rasterize();
+    void rasterizeTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+
+    std::vector<glm::vec3> occluders;
+    std::vector<float> depth;
+    glm::mat4 viewProjection;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool jobPending;
+    bool jobRunning;
+    bool quit;
+    bool frameValid;
+};
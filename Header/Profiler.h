@@ -0,0 +1,76 @@
+#pragma once
+
+// Per-frame counters and gauges, printed to the console every few seconds
+// while reporting is enabled (F3).
+enum ProfilerCounter {
+    PROF_TEXTURE_BUDGET_BYTES,
+    PROF_TEXTURE_RESIDENT_BYTES,
+    PROF_TEXTURE_EVICTIONS,
+    PROF_TEXTURE_RESTREAMS,
+    PROF_GPU_FRAME_US,
+    PROF_DRAW_CALLS,
+    PROF_GL_UNIFORM_CALLS,
+    PROF_UNIFORM_LOOKUPS,
+    PROF_INSTANCE_UPLOAD_BYTES,
+    PROF_QUEUED_ITEMS,
+    PROF_STATE_CHANGES,
+    PROF_GL_CALLS_ELIDED,
+    PROF_GL_STATE_MISMATCHES,
+    PROF_CULL_VISIBLE,
+    PROF_CULL_CULLED,
+    PROF_OCCLUSION_CULLED,
+    PROF_INDIRECT_COMMANDS,
+    PROF_CLUSTER_LIGHTS,
+    PROF_CLUSTER_LIGHT_REFS,
+    PROF_SHADOW_STATIC_UPDATES,
+    PROF_SHADOW_CASTERS,
+    PROF_RING_BYTES,
+    PROF_RING_FENCE_WAITS,
+    PROF_RENDER_SCALE_PERCENT,
+    PROF_COUNTER_COUNT
+};
+
+enum ProfilerCounterKind {
+    PROF_KIND_PER_FRAME,    // reset every frame, reported as a per-frame average
+    PROF_KIND_GAUGE,        // current value, reported as-is
+    PROF_KIND_TOTAL         // monotonically increasing since startup
+};
+
+enum ProfilerUnit {
+    PROF_UNIT_COUNT,
+    PROF_UNIT_BYTES,
+    PROF_UNIT_MICROSECONDS
+};
+
+extern long long profilerCounters[PROF_COUNTER_COUNT];
+
+inline void profilerAdd(ProfilerCounter counter, long long value = 1) {
+    profilerCounters[counter] += value;
+}
+
+inline void profilerSet(ProfilerCounter counter, long long value) {
+    profilerCounters[counter] = value;
+}
+
+inline long long profilerGet(ProfilerCounter counter) {
+    return profilerCounters[counter];
+}
+
+void profilerEndFrame(double now);
+// Value a per-frame counter reached in the most recently finished frame.
+long long profilerLastFrame(ProfilerCounter counter);
+void profilerSetReporting(bool enabled);
+bool profilerIsReporting();
+
+// GPU frame time from a small ring of GL_TIME_ELAPSED queries. Results are
+// picked up a few frames late without stalling and land in PROF_GPU_FRAME_US.
+void profilerGpuInit();
+void profilerGpuShutdown();
+void profilerGpuBeginFrame();
+void profilerGpuEndFrame();
+// Most recently resolved GPU frame time; sampleIndex counts resolved frames,
+// so a caller can tell a new sample from one it has already seen.
+double profilerGpuLastFrameMs(long long& sampleIndex);
+// Waits for all outstanding queries; returns the GPU milliseconds and number of
+// frames resolved since the previous drain.
+double profilerGpuDrain(int& frames);
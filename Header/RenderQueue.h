@@ -0,0 +1,127 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "ShaderProgram.h"
+#include "InstanceBuffer.h"
+#include "JobSystem.h"
+
+enum RenderPass {
+    PASS_OPAQUE,
+    PASS_OVERLAY,       // screen-space quads, kept in submission order
+    PASS_COUNT
+};
+
+enum DrawFlags {
+    DRAW_CULL_FACE = 1,
+    DRAW_DEPTH_TEST = 2,
+    DRAW_MODEL_MATRIX = 4,
+    DRAW_INDEXED = 8        // 32-bit indices from the VAO's element buffer
+};
+
+const int MAX_DRAW_UNIFORMS = 4;
+
+// A small uniform value carried by a draw item: an int when components is 0,
+// otherwise 1-3 floats.
+struct DrawUniform {
+    ShaderUniform uniform;
+    int components;
+    int intValue;
+    float value[3];
+};
+
+struct DrawItem {
+    const ShaderProgram* program;
+    GLuint vao;
+    GLuint texture;
+    int textureUnit;
+    GLenum textureTarget;   // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+    GLenum primitive;
+    GLint first;            // first vertex, or first index when DRAW_INDEXED
+    GLsizei count;
+    GLsizei instances;
+    GLint baseVertex;
+    GLuint baseInstance;
+    // Buffer the VAO's instance attributes read from; re-pointed at
+    // baseInstance when the driver lacks base-instance draws.
+    GLuint instanceBuffer;
+    int flags;
+    glm::mat4 model;
+    glm::mat3 normalMatrix;     // computed once by setModel
+    int uniformCount;
+    DrawUniform uniforms[MAX_DRAW_UNIFORMS];
+
+    DrawItem();
+
+    void setModel(const glm::mat4& matrix);
+    void setInt(ShaderUniform uniform, int value);
+    void setFloat(ShaderUniform uniform, float value);
+    void setVec2(ShaderUniform uniform, float x, float y);
+    void setVec3(ShaderUniform uniform, const glm::vec3& value);
+};
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Collects the frame's draws, orders them by a 64-bit key
+// (pass | program | VAO | texture | depth) with an LSD radix sort and issues
+// them, skipping program/VAO/texture/enable changes that would not change state.
+// The state part of a key is resolved at submit; the depth part is filled in
+// on job threads when the queue executes.
+// With GL 4.3 multi-draw-indirect, consecutive indexed items that bind the
+// same program, VAO and texture and set no uniforms of their own are issued
+// as one glMultiDrawElementsIndirect from a command buffer built once per frame.
+class RenderQueue {
+public:
+    RenderQueue();
+
+    void destroy();
+    void clear();
+    void submit(RenderPass pass, float depth, const DrawItem& item);
+    void execute(JobSystem& jobs);
+
+    int size() const { return (int)items.size(); }
+
+private:
+    uint64_t makeStateKey(RenderPass pass, const DrawItem& item);
+    void buildKeys(JobSystem& jobs);
+    uint32_t denseId(std::unordered_map<GLuint, uint32_t>& ids, GLuint name, uint32_t maxId);
+    void radixSort();
+    void applyUniforms(const DrawItem& item) const;
+    void attachInstances(const DrawItem& item);
+    void drawItem(const DrawItem& item, bool baseInstanceDraws);
+
+    struct DrawRun {
+        uint32_t start;
+        uint32_t count;
+        int command;        // first indirect command, or -1 for a plain draw
+    };
+
+    std::vector<DrawItem> items;
+    std::vector<uint64_t> stateKeys;
+    std::vector<float> depths;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> scratchKeys;
+    std::vector<uint32_t> scratchOrder;
+    std::vector<DrawRun> runs;
+    std::vector<DrawElementsIndirectCommand> commands;
+    GLuint indirectBuffer;
+
+    GLuint boundInstanceBuffer;
+    GLuint boundInstanceVao;
+    GLuint boundBaseInstance;
+
+    std::unordered_map<GLuint, uint32_t> programIds;
+    std::unordered_map<GLuint, uint32_t> vaoIds;
+    std::unordered_map<GLuint, uint32_t> textureIds;
+    uint32_t overlaySequence;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <GL/glew.h>
+#include <string>
+#include <unordered_map>
+
+#include "glm/glm.hpp"
+
+// Uniforms the renderer sets per draw. Their locations are looked up once when
+// the program is linked instead of by string on every call.
+enum ShaderUniform {
+    UNIFORM_MODEL,
+    UNIFORM_NORMAL_MATRIX,
+    UNIFORM_COLOR,
+    UNIFORM_ALPHA,
+    UNIFORM_TEXTURE,
+    UNIFORM_MATERIAL_TEXTURES,
+    UNIFORM_CLUSTER_OFFSETS,
+    UNIFORM_CLUSTER_INDICES,
+    UNIFORM_CLUSTER_LIGHTS,
+    UNIFORM_SHADOW_MAP,
+    UNIFORM_LIGHT_SPACE,
+    UNIFORM_BAKED_ROOM_LIGHT,
+    UNIFORM_BAKED_PROJECTOR_LIGHT,
+    UNIFORM_USE_LIGHTING,
+    UNIFORM_USE_TEXTURE,
+    UNIFORM_EMISSION_COLOR,
+    UNIFORM_EMISSION_STRENGTH,
+    UNIFORM_OVERLAY_POS,
+    UNIFORM_OVERLAY_SIZE,
+    UNIFORM_COUNT
+};
+
+const GLuint FRAME_DATA_BINDING = 0;
+const GLuint CLUSTER_DATA_BINDING = 1;
+
+// Mirrors the std140 FrameData block declared in basic.vert/frag and screen.vert.
+// vec3 values are stored as vec4 so the C++ layout matches std140 padding.
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+    glm::vec4 viewPos;
+    glm::mat4 lightSpace;
+    glm::vec4 shadowParams;     // enabled, depth bias, texel size
+};
+static_assert(sizeof(FrameData) == 256, "FrameData must match the std140 block layout");
+
+class ShaderProgram {
+public:
+    ShaderProgram();
+
+    bool create(const char* vsPath, const char* fsPath, const std::string& defines = "");
+    void destroy();
+
+    GLuint id() const { return program; }
+    void use() const;
+
+    bool has(ShaderUniform uniform) const { return locations[uniform] >= 0; }
+    GLint location(const std::string& name) const;
+
+    void setInt(ShaderUniform uniform, int value) const;
+    void setFloat(ShaderUniform uniform, float value) const;
+    void setVec2(ShaderUniform uniform, float x, float y) const;
+    void setVec3(ShaderUniform uniform, const glm::vec3& value) const;
+    void setMat3(ShaderUniform uniform, const glm::mat3& value) const;
+    void setMat4(ShaderUniform uniform, const glm::mat4& value) const;
+
+    // Benchmark comparison: resolve every set by name with glGetUniformLocation,
+    // as the renderer did before the locations were reflected at link time.
+    static void setLookupByName(bool enabled);
+
+private:
+    void reflect();
+    GLint resolve(ShaderUniform uniform) const;
+
+    GLuint program;
+    GLint locations[UNIFORM_COUNT];
+    std::unordered_map<std::string, GLint> uniforms;
+};
+
+// Binds the frame's FrameData, written by the caller at offset in buffer (a
+// multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT), to FRAME_DATA_BINDING.
+void frameDataBind(GLuint buffer, GLintptr offset);
@@ -0,0 +1,45 @@
+#pragma once
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+// Texture unit the shadow map stays bound to for basic.frag.
+const int SHADOW_MAP_UNIT = 5;
+
+// A shadow map split into a cached static layer and a per-frame dynamic layer.
+// The static layer is rendered only when its key changes (whatever decides
+// the light and the static casters). Each frame that has moving casters
+// copies the static depth into the dynamic layer with a blit and draws just
+// those casters on top, so the per-frame cost follows the number of movers.
+class ShadowMapCache {
+public:
+    ShadowMapCache();
+
+    void create(int size);
+    void destroy();
+
+    void beginFrame(const glm::mat4& lightSpace);
+    bool needsStaticUpdate(unsigned long long key) const;
+    // Binds the static layer's framebuffer, cleared, for the static casters.
+    void beginStatic(unsigned long long key);
+    // Binds the dynamic layer's framebuffer, primed with the static depth.
+    void beginDynamic();
+    // Back to the default framebuffer; the caller restores its viewport.
+    void end();
+
+    // The layer to sample this frame: dynamic if it was drawn, else static.
+    GLuint getTexture() const { return dynamicUsed ? dynamicDepth : staticDepth; }
+    const glm::mat4& getLightSpace() const { return lightSpace; }
+    int getSize() const { return size; }
+
+private:
+    GLuint createDepthTexture();
+
+    GLuint staticDepth, dynamicDepth;
+    GLuint staticFbo, dynamicFbo;
+    int size;
+    glm::mat4 lightSpace;
+    unsigned long long staticKey;
+    bool staticValid;
+    bool dynamicUsed;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. push fails instead of blocking when the queue is full.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(const T& item) {
+        size_t current = head.load(std::memory_order_relaxed);
+        size_t next = (current + 1) % Capacity;
+        if (next == tail.load(std::memory_order_acquire)) return false;
+        items[current] = item;
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t current = tail.load(std::memory_order_relaxed);
+        if (current == head.load(std::memory_order_acquire)) return false;
+        item = items[current];
+        tail.store((current + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity];
+    std::atomic<size_t> head;   // next slot to write, owned by the producer
+    std::atomic<size_t> tail;   // next slot to read, owned by the consumer
+};
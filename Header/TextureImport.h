@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct ImportedImage {
+    std::vector<unsigned char> pixels;
+    int width, height, channels;
+    int sourceWidth, sourceHeight;
+};
+
+// Loads an image (bottom-up, like loadImageToTexture) and, when it is larger than
+// maxDimension on either axis, downscales it with a Lanczos-3 filter. Downscaled
+// results are cached under Cache/textures keyed by path, size and timestamp of
+// the source, so later launches skip both the decode and the resample.
+// The source size is not probed here: callers that already know it pass 0
+// when the image fits, and any other limit is looked up in the cache first.
+bool importImage(const std::string& path, int maxDimension, ImportedImage& out);
+bool readImageSize(const std::string& path, int& width, int& height, int& channels);
+
+void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, int channels,
+                   unsigned char* dst, int dstWidth, int dstHeight);
+
+size_t textureMipChainBytes(int width, int height, int channels);
+
+// Mean colour of an image in 0-1; one- and two-channel images give grey.
+void imageAverageColor(const unsigned char* pixels, int width, int height, int channels, float rgb[3]);
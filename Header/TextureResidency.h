@@ -0,0 +1,86 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureImport.h"
+
+struct TextureResidencyStats {
+    size_t budgetBytes;
+    size_t residentBytes;
+    unsigned long long evictions;
+    unsigned long long restreams;
+};
+
+struct TextureLoadInfo {
+    int sourceWidth, sourceHeight;
+    int width, height;
+    int channels;
+    float averageColor[3];      // from the decoded pixels, so callers never read back from the GPU
+};
+
+struct TextureArrayInfo {
+    std::vector<int> arrays;    // array of each requested path, -1 if it failed to load
+    std::vector<int> layers;    // layer of each requested path within its array
+    std::vector<int> widths, heights;   // layer size of each array
+    size_t sourceBytes;
+    size_t importedBytes;
+};
+
+// Tracks the VRAM footprint of file-backed textures and keeps it under a budget.
+// Under pressure the least-recently-used textures lose their top mip level (the
+// GL name stays valid, only the storage shrinks); touching a degraded texture
+// queues it to be restreamed at its import resolution. Both work from a copy
+// of the imported pixels kept in system memory, so neither reads back from
+// the GPU nor decodes the file again mid-frame. Texture arrays degrade the
+// same way, all of their layers at once.
+class TextureResidency {
+public:
+    explicit TextureResidency(size_t budgetBytes);
+
+    GLuint load(const std::string& path, GLint wrapMode, int maxDimension = 0, TextureLoadInfo* info = nullptr);
+    // A single-level, linearly filtered texture for screen-space overlays,
+    // which are drawn at a fixed size; counted but never degraded.
+    GLuint loadOverlay(const std::string& path);
+    // Imports every path as RGBA and groups the images by size; each group
+    // becomes a GL_TEXTURE_2D_ARRAY with one layer per image, so no image is
+    // resampled to fit another.
+    std::vector<GLuint> loadArrays(const std::vector<std::string>& paths, const std::vector<int>& maxDimensions,
+                                   GLint wrapMode, TextureArrayInfo* info = nullptr);
+    void touch(GLuint texture);
+    void beginFrame();
+    void release(GLuint texture);
+    void releaseAll();
+
+    void setBudget(size_t bytes);
+    const TextureResidencyStats& getStats() const { return stats; }
+
+private:
+    struct Entry {
+        std::vector<unsigned char> pixels;  // import-resolution level 0 of every layer, kept for degradable textures
+        GLenum target;
+        int fullWidth, fullHeight;
+        int width, height;
+        int channels;
+        int droppedMips;
+        int layers;             // 0 for a plain 2D texture
+        bool mipmapped;
+        size_t bytes;
+        unsigned long long lastUsedFrame;
+        unsigned long long nextRestreamFrame;
+        bool restreamRequested;
+    };
+
+    GLuint create(const ImportedImage& image, bool mipmapped, GLint wrapMode, Entry& entry);
+    void upload(Entry& entry, const unsigned char* pixels, int width, int height);
+    bool dropTopMip(GLuint texture, Entry& entry);
+    bool restream(GLuint texture, Entry& entry);
+    bool evictLeastRecentlyUsed(GLuint keep);
+    void publishStats();
+
+    std::unordered_map<GLuint, Entry> entries;
+    TextureResidencyStats stats;
+    unsigned long long frame;
+};
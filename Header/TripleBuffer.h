@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+
+// Lock-free hand-off of whole values from one writer thread to one reader
+// thread. The writer fills writeBuffer() and publishes it; the reader picks
+// up the newest published value with acquire() and keeps reading it until
+// the next acquire. A published value is never touched by the writer again
+// until the reader has let go of it, and the writer never waits: if it
+// publishes faster than the reader acquires, older values are overwritten.
+// Buffers are reused, so containers inside T keep their capacity.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : shared(1), writeIndex(0), readIndex(2) {}
+
+    T& writeBuffer() { return buffers[writeIndex]; }
+
+    void publish() {
+        writeIndex = shared.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Returns false (keeping the current read buffer) if nothing new was published.
+    bool acquire() {
+        if (!(shared.load(std::memory_order_relaxed) & FRESH_BIT)) return false;
+        readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static const int FRESH_BIT = 4;
+    static const int INDEX_MASK = 3;
+
+    T buffers[3];
+    // Index of the buffer between writer and reader, plus FRESH_BIT while it
+    // holds a value the reader has not taken yet.
+    std::atomic<int> shared;
+    int writeIndex;
+    int readIndex;
+};
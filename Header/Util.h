@@ -4,5 +4,14 @@
 #include <string>
 int endProgram(std::string message);
 unsigned int createShader(const char* vsSource, const char* fsSource);
+unsigned int createShaderVariant(const char* vsSource, const char* fsSource, const std::string& defines);
 unsigned loadImageToTexture(const char* filePath);
-GLFWcursor* loadImageToCursor(const char* filePath);
\ No newline at end of file
+unsigned char* loadImagePixels(const char* filePath, int* width, int* height, int* channels);
+void freeImagePixels(unsigned char* pixels);
+GLenum textureFormatForChannels(int channels);
+GLFWcursor* loadImageToCursor(const char* filePath);
+// CPU time used by the whole process so far, in seconds.
+double processCpuSeconds();
+// Blocks until glfwGetTime() reaches the deadline: an OS sleep for most of
+// the wait, then yielding for the last stretch the scheduler can overshoot.
+void preciseSleepUntil(double deadline);
\ No newline at end of file
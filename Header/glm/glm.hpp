@@ -377,6 +377,10 @@ inline const float* value_ptr(const mat4& m) {
     return &m[0][0];
 }
 
+inline const float* value_ptr(const mat3& m) {
+    return &m[0][0];
+}
+
 inline const float* value_ptr(const vec3& v) {
     return &v[0];
 }
@@ -1,44 +1,159 @@
 #version 330 core
+// Compiled per feature mask with USE_LIGHTING / USE_TEXTURE / USE_INSTANCING /
+// USE_VERTEX_COLOR / USE_MATERIAL_ARRAY / USE_BAKED_LIGHTING defined as needed.
+// UBER_SHADER keeps the original per-fragment uniform branches for comparison.
 out vec4 FragColor;
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
+#if defined(USE_INSTANCING) || defined(USE_VERTEX_COLOR)
+in vec3 VertexColor;
+#endif
+#ifdef USE_MATERIAL_ARRAY
+flat in vec4 Material;
+uniform sampler2DArray uMaterialTextures;
+#endif
+#ifdef USE_BAKED_LIGHTING
+// Irradiance baked for a unit white light (rgb) and its direct share (a),
+// one per main light position, scaled by that light's current colour.
+in vec4 BakedRoom;
+in vec4 BakedProjector;
+uniform vec3 uBakedRoomLight;
+uniform vec3 uBakedProjectorLight;
+#endif
+
+layout(std140) uniform FrameData {
+    mat4 uProjection;
+    mat4 uView;
+    vec4 uLightPos;
+    vec4 uLightColor;
+    vec4 uViewPos;
+    mat4 uLightSpace;
+    vec4 uShadowParams;     // enabled, depth bias, texel size
+};
 
 uniform vec3 uColor;
-uniform vec3 uLightPos;
-uniform vec3 uLightColor;
-uniform vec3 uViewPos;
-uniform bool uUseLighting;
-uniform bool uUseTexture;
 uniform sampler2D uTexture;
 uniform float uAlpha;
 
+uniform sampler2DShadow uShadowMap;
+
+// 1 when lit by the main light, 0 in its shadow; 2x2 hardware-filtered taps.
+float shadowFactor() {
+    if (uShadowParams.x < 0.5) return 1.0;
+    vec4 lightClip = uLightSpace * vec4(FragPos, 1.0);
+    if (lightClip.w <= 0.0) return 1.0;
+    vec3 coord = lightClip.xyz / lightClip.w * 0.5 + 0.5;
+    if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0)))) return 1.0;
+
+    float reference = coord.z - uShadowParams.y;
+    float texel = uShadowParams.z;
+    float lit = 0.0;
+    lit += texture(uShadowMap, vec3(coord.xy + vec2(-0.5, -0.5) * texel, reference));
+    lit += texture(uShadowMap, vec3(coord.xy + vec2( 0.5, -0.5) * texel, reference));
+    lit += texture(uShadowMap, vec3(coord.xy + vec2(-0.5,  0.5) * texel, reference));
+    lit += texture(uShadowMap, vec3(coord.xy + vec2( 0.5,  0.5) * texel, reference));
+    return lit * 0.25;
+}
+
+// Clustered point lights, binned per froxel on the CPU (ClusteredLighting).
+layout(std140) uniform ClusterData {
+    vec4 uClusterGrid;      // tiles x, tiles y, slices, light count
+    vec4 uClusterDepth;     // near, slice scale, slice bias, far
+    vec4 uClusterTileSize;
+};
+uniform usamplerBuffer uClusterOffsets;
+uniform usamplerBuffer uClusterIndices;
+uniform samplerBuffer uClusterLights;
+
+vec3 clusterLighting(vec3 norm, vec3 baseColor) {
+    float depth = -(uView * vec4(FragPos, 1.0)).z;
+    int slice = int(max(log(depth) * uClusterDepth.y + uClusterDepth.z, 0.0));
+    ivec3 cell = min(ivec3(ivec2(gl_FragCoord.xy / uClusterTileSize.xy), slice), ivec3(uClusterGrid.xyz) - 1);
+    int cluster = cell.x + int(uClusterGrid.x) * (cell.y + int(uClusterGrid.y) * cell.z);
+    uvec2 range = texelFetch(uClusterOffsets, cluster).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(uClusterIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(uClusterLights, light * 2);
+        vec3 color = texelFetch(uClusterLights, light * 2 + 1).rgb;
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float dist = length(toLight);
+        float falloff = clamp(1.0 - dist / positionRadius.w, 0.0, 1.0);
+        float diff = max(dot(norm, toLight / max(dist, 0.0001)), 0.0);
+        result += diff * falloff * falloff * color * baseColor;
+    }
+    return result;
+}
+
+#ifdef UBER_SHADER
+uniform bool uUseLighting;
+uniform bool uUseTexture;
+#else
+#ifdef USE_LIGHTING
+const bool uUseLighting = true;
+#else
+const bool uUseLighting = false;
+#endif
+#ifdef USE_TEXTURE
+const bool uUseTexture = true;
+#else
+const bool uUseTexture = false;
+#endif
+#endif
+
 void main() {
-    vec3 baseColor = uUseTexture ? texture(uTexture, TexCoord).rgb : uColor;
+#if defined(USE_VERTEX_COLOR) || defined(USE_INSTANCING)
+    // Instances carry their own colour, so instanced draws set no uniform
+    // and can share one indirect multi-draw.
+    vec3 baseColor = VertexColor;
+#else
+    vec3 baseColor = uColor;
+#endif
     float alpha = uAlpha;
+#ifdef USE_MATERIAL_ARRAY
+    // Textured material groups sample their layer, the rest use their colour.
+    vec4 material = Material.w >= 0.0 ? texture(uMaterialTextures, vec3(TexCoord, Material.w))
+                                      : vec4(Material.rgb, 1.0);
+    baseColor *= material.rgb;
+    alpha *= material.a;
+#endif
 
     if (uUseTexture) {
-        alpha = texture(uTexture, TexCoord).a * uAlpha;
+        vec4 texel = texture(uTexture, TexCoord);
+        baseColor = texel.rgb;
+        alpha = texel.a * uAlpha;
     }
 
     if (uUseLighting) {
+#ifdef USE_BAKED_LIGHTING
+        // Static shadows are already in the bake; the shadow map only removes
+        // the direct share where a moving caster blocks the light.
+        float shadow = shadowFactor();
+        vec3 irradiance = uBakedRoomLight * BakedRoom.rgb * (1.0 - BakedRoom.a * (1.0 - shadow)) +
+                          uBakedProjectorLight * BakedProjector.rgb * (1.0 - BakedProjector.a * (1.0 - shadow));
+        FragColor = vec4(irradiance * baseColor + clusterLighting(normalize(Normal), baseColor), alpha);
+        return;
+#endif
         float ambientStrength = 0.35;
-        vec3 ambient = ambientStrength * uLightColor * baseColor;
+        vec3 ambient = ambientStrength * uLightColor.rgb * baseColor;
 
         vec3 norm = normalize(Normal);
-        vec3 lightDir = normalize(uLightPos - FragPos);
+        vec3 lightDir = normalize(uLightPos.xyz - FragPos);
         float diff = max(dot(norm, lightDir), 0.0);
         float wrapDiff = max(dot(norm, lightDir) * 0.5 + 0.5, 0.0);
-        vec3 diffuse = mix(diff, wrapDiff, 0.3) * uLightColor * baseColor;
+        vec3 diffuse = mix(diff, wrapDiff, 0.3) * uLightColor.rgb * baseColor;
 
         float specularStrength = 0.25;
-        vec3 viewDir = normalize(uViewPos - FragPos);
+        vec3 viewDir = normalize(uViewPos.xyz - FragPos);
         vec3 reflectDir = reflect(-lightDir, norm);
         float spec = pow(max(dot(viewDir, reflectDir), 0.0), 16.0);
-        vec3 specular = specularStrength * spec * uLightColor;
+        vec3 specular = specularStrength * spec * uLightColor.rgb;
 
-        FragColor = vec4(ambient + diffuse + specular, alpha);
+        float shadow = shadowFactor();
+        FragColor = vec4(ambient + shadow * (diffuse + specular) + clusterLighting(norm, baseColor), alpha);
     } else {
         FragColor = vec4(baseColor, alpha);
     }
@@ -3,17 +3,79 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
+layout(std140) uniform FrameData {
+    mat4 uProjection;
+    mat4 uView;
+    vec4 uLightPos;
+    vec4 uLightColor;
+    vec4 uViewPos;
+    mat4 uLightSpace;
+    vec4 uShadowParams;     // enabled, depth bias, texel size
+};
+
+#ifdef USE_INSTANCING
+layout(location = 3) in vec4 aModelRow0;
+layout(location = 4) in vec4 aModelRow1;
+layout(location = 5) in vec4 aModelRow2;
+layout(location = 6) in vec4 aInstanceColor;
+layout(location = 9) in vec4 aNormalScale;
+#else
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+uniform mat3 uNormalMatrix;
+#endif
+
+#ifdef USE_VERTEX_COLOR
+layout(location = 7) in vec3 aVertexColor;
+#endif
+
+#ifdef USE_MATERIAL_ARRAY
+layout(location = 8) in vec4 aMaterial;
+flat out vec4 Material;
+#endif
+
+#if defined(USE_INSTANCING) || defined(USE_VERTEX_COLOR)
+out vec3 VertexColor;
+#endif
+
+#ifdef USE_BAKED_LIGHTING
+layout(location = 10) in vec4 aBakedRoom;
+layout(location = 11) in vec4 aBakedProjector;
+out vec4 BakedRoom;
+out vec4 BakedProjector;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
 
 void main() {
-    FragPos = vec3(uModel * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(uModel))) * aNormal;
+#ifdef USE_INSTANCING
+    mat4 model = transpose(mat4(aModelRow0, aModelRow1, aModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+    VertexColor = aInstanceColor.rgb;
+#else
+    mat4 model = uModel;
+#endif
+#ifdef USE_VERTEX_COLOR
+    VertexColor = aVertexColor;
+#endif
+#ifdef USE_MATERIAL_ARRAY
+    Material = aMaterial;
+#endif
+#ifdef USE_BAKED_LIGHTING
+    BakedRoom = aBakedRoom;
+    BakedProjector = aBakedProjector;
+#endif
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    FragPos = worldPos.xyz;
+#if defined(NORMAL_MATRIX_PER_VERTEX)
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+#elif defined(USE_INSTANCING)
+    // Rotate-scale instances: dividing by the squared axis scale before the
+    // model's 3x3 equals the inverse transpose.
+    Normal = mat3(model) * (aNormalScale.xyz * aNormal);
+#else
+    Normal = uNormalMatrix * aNormal;
+#endif
     TexCoord = aTexCoord;
-    gl_Position = uProjection * uView * uModel * vec4(aPos, 1.0);
+    gl_Position = uProjection * uView * worldPos;
 }
@@ -3,9 +3,17 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
+layout(std140) uniform FrameData {
+    mat4 uProjection;
+    mat4 uView;
+    vec4 uLightPos;
+    vec4 uLightColor;
+    vec4 uViewPos;
+    mat4 uLightSpace;
+    vec4 uShadowParams;     // enabled, depth bias, texel size
+};
+
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
 
 out vec2 TexCoord;
 
@@ -0,0 +1,4 @@
+#version 330 core
+// Depth only; the shadow framebuffers have no colour attachment.
+void main() {
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+#ifdef USE_INSTANCING
+layout(location = 3) in vec4 aModelRow0;
+layout(location = 4) in vec4 aModelRow1;
+layout(location = 5) in vec4 aModelRow2;
+#else
+uniform mat4 uModel;
+#endif
+
+uniform mat4 uLightSpace;
+
+void main() {
+#ifdef USE_INSTANCING
+    mat4 model = transpose(mat4(aModelRow0, aModelRow1, aModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+#else
+    mat4 model = uModel;
+#endif
+    gl_Position = uLightSpace * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,173 @@
+#include "../Header/ClusteredLighting.h"
+#include "../Header/ShaderProgram.h"
+#include "../Header/GLState.h"
+#include "../Header/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+ClusteredLighting::ClusteredLighting()
+    : offsetsBuffer(0), indicesBuffer(0), lightsBuffer(0),
+      offsetsTexture(0), indicesTexture(0), lightsTexture(0), uniformBuffer(0), lightCount(0) {}
+
+void ClusteredLighting::create() {
+    destroy();
+    glGenBuffers(1, &offsetsBuffer);
+    glGenBuffers(1, &indicesBuffer);
+    glGenBuffers(1, &lightsBuffer);
+    glGenTextures(1, &offsetsTexture);
+    glGenTextures(1, &indicesTexture);
+    glGenTextures(1, &lightsTexture);
+
+    // A buffer texture needs storage before glTexBuffer; start with one element.
+    uint32_t zero[4] = { 0, 0, 0, 0 };
+    uploadBuffer(offsetsBuffer, zero, sizeof(zero));
+    uploadBuffer(indicesBuffer, zero, sizeof(zero));
+    uploadBuffer(lightsBuffer, zero, sizeof(zero));
+
+    glState.bindTexture(CLUSTER_OFFSETS_UNIT, offsetsTexture, GL_TEXTURE_BUFFER);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, offsetsBuffer);
+    glState.bindTexture(CLUSTER_INDICES_UNIT, indicesTexture, GL_TEXTURE_BUFFER);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indicesBuffer);
+    glState.bindTexture(CLUSTER_LIGHTS_UNIT, lightsTexture, GL_TEXTURE_BUFFER);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightsBuffer);
+
+    glGenBuffers(1, &uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_DATA_BINDING, uniformBuffer);
+
+    offsets.assign((size_t)CLUSTER_COUNT * 2, 0);
+}
+
+void ClusteredLighting::destroy() {
+    GLuint textures[3] = { offsetsTexture, indicesTexture, lightsTexture };
+    for (GLuint texture : textures) {
+        if (!texture) continue;
+        glState.forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+    GLuint buffers[4] = { offsetsBuffer, indicesBuffer, lightsBuffer, uniformBuffer };
+    for (GLuint buffer : buffers) {
+        if (buffer) glDeleteBuffers(1, &buffer);
+    }
+    offsetsBuffer = indicesBuffer = lightsBuffer = uniformBuffer = 0;
+    offsetsTexture = indicesTexture = lightsTexture = 0;
+}
+
+void ClusteredLighting::uploadBuffer(GLuint buffer, const void* data, size_t bytes) {
+    // Orphaned every frame, so the driver never waits on last frame's reads.
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)bytes, data, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+static int tileIndex(float ndc, int tiles) {
+    int tile = (int)floorf((ndc * 0.5f + 0.5f) * tiles);
+    return std::min(std::max(tile, 0), tiles - 1);
+}
+
+void ClusteredLighting::build(const std::vector<PointLight>& lights, const glm::mat4& view, float fovY,
+                              float aspect, float zNear, float zFar, int viewportWidth, int viewportHeight) {
+    float tanHalf = tanf(fovY * 0.5f);
+    float scaleX = 1.0f / (aspect * tanHalf);
+    float scaleY = 1.0f / tanHalf;
+    float logRange = logf(zFar / zNear);
+    float sliceScale = CLUSTER_SLICES / logRange;
+    float sliceBias = -CLUSTER_SLICES * logf(zNear) / logRange;
+
+    lightData.clear();
+    lightRanges.clear();
+    std::fill(offsets.begin(), offsets.end(), 0u);
+
+    // Pass 1: the froxel range each light's view-space bounding box touches,
+    // counted per cluster.
+    for (const PointLight& light : lights) {
+        glm::vec3 center(view * glm::vec4(light.position, 1.0f));
+        float depth = -center.z;
+        float r = light.radius;
+        if (depth + r <= zNear || depth - r >= zFar) continue;
+        float dMin = std::max(depth - r, zNear);
+        float dMax = std::min(depth + r, zFar);
+
+        // x/d is monotonic in d for a fixed x, so the box corners bound the projection.
+        float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+        for (int i = 0; i < 4; i++) {
+            float d = (i & 1) ? dMax : dMin;
+            float x = ((i & 2) ? center.x + r : center.x - r) * scaleX / d;
+            float y = ((i & 2) ? center.y + r : center.y - r) * scaleY / d;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+        if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f) continue;
+
+        int range[6];
+        range[0] = tileIndex(minX, CLUSTER_TILES_X);
+        range[1] = tileIndex(maxX, CLUSTER_TILES_X);
+        range[2] = tileIndex(minY, CLUSTER_TILES_Y);
+        range[3] = tileIndex(maxY, CLUSTER_TILES_Y);
+        range[4] = std::min(std::max((int)floorf(logf(dMin) * sliceScale + sliceBias), 0), CLUSTER_SLICES - 1);
+        range[5] = std::min(std::max((int)floorf(logf(dMax) * sliceScale + sliceBias), 0), CLUSTER_SLICES - 1);
+
+        for (int z = range[4]; z <= range[5]; z++) {
+            for (int y = range[2]; y <= range[3]; y++) {
+                for (int x = range[0]; x <= range[1]; x++) {
+                    int cluster = x + CLUSTER_TILES_X * (y + CLUSTER_TILES_Y * z);
+                    offsets[(size_t)cluster * 2 + 1]++;
+                }
+            }
+        }
+        lightRanges.insert(lightRanges.end(), range, range + 6);
+        lightData.push_back(glm::vec4(light.position, light.radius));
+        lightData.push_back(glm::vec4(light.color, 0.0f));
+    }
+    lightCount = (int)lightData.size() / 2;
+
+    // Pass 2: prefix sum into offsets, then scatter the light indices.
+    uint32_t total = 0;
+    for (int c = 0; c < CLUSTER_COUNT; c++) {
+        offsets[(size_t)c * 2] = total;
+        total += offsets[(size_t)c * 2 + 1];
+        offsets[(size_t)c * 2 + 1] = 0;
+    }
+    indices.resize(total);
+    for (int light = 0; light < lightCount; light++) {
+        const int* range = &lightRanges[(size_t)light * 6];
+        for (int z = range[4]; z <= range[5]; z++) {
+            for (int y = range[2]; y <= range[3]; y++) {
+                for (int x = range[0]; x <= range[1]; x++) {
+                    size_t cluster = (size_t)(x + CLUSTER_TILES_X * (y + CLUSTER_TILES_Y * z));
+                    indices[offsets[cluster * 2] + offsets[cluster * 2 + 1]++] = (uint32_t)light;
+                }
+            }
+        }
+    }
+
+    clusterData.grid = glm::vec4((float)CLUSTER_TILES_X, (float)CLUSTER_TILES_Y, (float)CLUSTER_SLICES,
+                                 (float)lightCount);
+    clusterData.depth = glm::vec4(zNear, sliceScale, sliceBias, zFar);
+    clusterData.tileSize = glm::vec4((float)viewportWidth / CLUSTER_TILES_X, (float)viewportHeight / CLUSTER_TILES_Y,
+                                     0.0f, 0.0f);
+}
+
+void ClusteredLighting::upload() {
+    uploadBuffer(offsetsBuffer, offsets.data(), offsets.size() * sizeof(uint32_t));
+    if (!indices.empty()) uploadBuffer(indicesBuffer, indices.data(), indices.size() * sizeof(uint32_t));
+    if (!lightData.empty()) uploadBuffer(lightsBuffer, lightData.data(), lightData.size() * sizeof(glm::vec4));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterData), &clusterData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    profilerSet(PROF_CLUSTER_LIGHTS, lightCount);
+    profilerAdd(PROF_CLUSTER_LIGHT_REFS, (long long)indices.size());
+}
+
+void ClusteredLighting::bind() const {
+    glState.bindTexture(CLUSTER_OFFSETS_UNIT, offsetsTexture, GL_TEXTURE_BUFFER);
+    glState.bindTexture(CLUSTER_INDICES_UNIT, indicesTexture, GL_TEXTURE_BUFFER);
+    glState.bindTexture(CLUSTER_LIGHTS_UNIT, lightsTexture, GL_TEXTURE_BUFFER);
+}
@@ -0,0 +1,157 @@
+#include "../Header/DynamicResolution.h"
+#include "../Header/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+// Timer results lag this many frames, so they still measure the old scale.
+const int STALE_SAMPLES = 4;
+// Fresh samples averaged before the next decision.
+const int SETTLE_SAMPLES = 6;
+const double SMOOTHING = 0.3;
+const float SCALE_STEP = 0.05f;
+const float MAX_SCALE_DROP = 0.25f;
+// A step up must be predicted to land this far under the target.
+const float RAISE_HEADROOM = 0.9f;
+const float SCALE_LIMIT_MIN = 0.25f;
+const float DEFAULT_TARGET_MS = 12.0f;
+
+DynamicResolution::DynamicResolution()
+    : settings({ DEFAULT_TARGET_MS, 0.5f, 1.0f }), fbo(0), colorBuffer(0), depthBuffer(0), targetWidth(0),
+      targetHeight(0), windowWidth(0), windowHeight(0), renderWidth(0), renderHeight(0), enabled(true),
+      scale(1.0f), smoothedMs(0.0), samplesSinceChange(0), reportStartScale(1.0f) {}
+
+void DynamicResolution::create(const DynamicResolutionSettings& requested) {
+    destroy();
+    settings = requested;
+    settings.maxScale = std::min(std::max(settings.maxScale, SCALE_LIMIT_MIN), 1.0f);
+    settings.minScale = std::min(std::max(settings.minScale, SCALE_LIMIT_MIN), settings.maxScale);
+    if (settings.targetMs <= 0.0f) settings.targetMs = DEFAULT_TARGET_MS;
+    scale = reportStartScale = settings.maxScale;
+    smoothedMs = 0.0;
+    samplesSinceChange = 0;
+    history.clear();
+    profilerSet(PROF_RENDER_SCALE_PERCENT, (long long)(getScale() * 100.0f + 0.5f));
+
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+}
+
+void DynamicResolution::destroy() {
+    if (fbo) glDeleteFramebuffers(1, &fbo);
+    if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+    fbo = colorBuffer = depthBuffer = 0;
+    targetWidth = targetHeight = 0;
+    windowWidth = windowHeight = 0;
+}
+
+void DynamicResolution::allocate(int width, int height) {
+    windowWidth = width;
+    windowHeight = height;
+    targetWidth = std::max(1, (int)ceilf(width * settings.maxScale));
+    targetHeight = std::max(1, (int)ceilf(height * settings.maxScale));
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, targetWidth, targetHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Scene framebuffer incomplete, dynamic resolution disabled" << std::endl;
+        enabled = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DynamicResolution::update(double gpuMs, double now) {
+    if (!enabled || gpuMs <= 0.0) return;
+    samplesSinceChange++;
+    if (samplesSinceChange <= STALE_SAMPLES) return;
+    smoothedMs = smoothedMs > 0.0 ? smoothedMs + (gpuMs - smoothedMs) * SMOOTHING : gpuMs;
+    if (samplesSinceChange < STALE_SAMPLES + SETTLE_SAMPLES) return;
+
+    float next;
+    if (smoothedMs > settings.targetMs) {
+        float fit = scale * sqrtf((float)(settings.targetMs / smoothedMs));
+        next = std::max(fit, scale - MAX_SCALE_DROP);
+        next = floorf(next / SCALE_STEP + 1e-3f) * SCALE_STEP;
+    } else {
+        float fit = scale * sqrtf((float)(settings.targetMs * RAISE_HEADROOM / smoothedMs));
+        next = std::min(fit, scale + SCALE_STEP);
+        next = std::max(floorf(next / SCALE_STEP + 1e-3f) * SCALE_STEP, scale);
+    }
+    next = std::min(std::max(next, settings.minScale), settings.maxScale);
+    if (fabsf(next - scale) < 1e-4f) return;
+
+    scale = next;
+    history.push_back({ now, scale, (float)smoothedMs });
+    samplesSinceChange = 0;
+    smoothedMs = 0.0;
+    profilerSet(PROF_RENDER_SCALE_PERCENT, (long long)(scale * 100.0f + 0.5f));
+}
+
+void DynamicResolution::prepare(int width, int height, int& outWidth, int& outHeight) {
+    if (enabled && (width != windowWidth || height != windowHeight)) allocate(width, height);
+    if (!enabled) {
+        renderWidth = width;
+        renderHeight = height;
+    } else {
+        renderWidth = std::min(targetWidth, std::max(1, (int)(width * scale + 0.5f)));
+        renderHeight = std::min(targetHeight, std::max(1, (int)(height * scale + 0.5f)));
+    }
+    outWidth = renderWidth;
+    outHeight = renderHeight;
+}
+
+void DynamicResolution::begin() {
+    glBindFramebuffer(GL_FRAMEBUFFER, enabled ? fbo : 0);
+    glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void DynamicResolution::resolve() {
+    if (!enabled) return;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, windowWidth, windowHeight,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void DynamicResolution::report(double now) {
+    if (!enabled) return;
+    char line[64];
+    snprintf(line, sizeof(line), "Resolution scale %.2f", reportStartScale);
+    std::string text = line;
+    for (const ScaleChange& change : history) {
+        snprintf(line, sizeof(line), " -> %.2f (%.1f s ago, gpu %.1f ms)", change.scale, now - change.time,
+                 change.gpuMs);
+        text += line;
+    }
+    if (history.empty()) text += " (steady)";
+    snprintf(line, sizeof(line), ", %dx%d, target %.1f ms", renderWidth, renderHeight, settings.targetMs);
+    std::cout << text << line << std::endl;
+    history.clear();
+    reportStartScale = scale;
+}
+
+void DynamicResolution::setEnabled(bool on) {
+    enabled = on;
+    // Start over at full scale so the controller re-measures from there.
+    scale = settings.maxScale;
+    samplesSinceChange = 0;
+    smoothedMs = 0.0;
+    history.clear();
+    reportStartScale = scale;
+    windowWidth = windowHeight = 0;
+    profilerSet(PROF_RENDER_SCALE_PERCENT, (long long)(getScale() * 100.0f + 0.5f));
+}
@@ -0,0 +1,108 @@
+#include "../Header/FrameRingBuffer.h"
+#include "../Header/Profiler.h"
+
+#include <iostream>
+
+// How long one glClientWaitSync blocks before checking again.
+const GLuint64 RING_WAIT_TIMEOUT_NS = 1000000;
+
+FrameRingBuffer::FrameRingBuffer()
+    : buffer(0), frameBytes(0), uniformAlignment(256), persistent(false), mapped(nullptr), fences(),
+      region(0), used(0), flushed(0), overflowReported(false) {}
+
+void FrameRingBuffer::create(size_t bytes) {
+    destroy();
+    frameBytes = bytes;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0) uniformAlignment = (size_t)alignment;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    persistent = GLEW_ARB_buffer_storage != 0;
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr total = (GLsizeiptr)(frameBytes * RING_FRAMES);
+        glBufferStorage(GL_ARRAY_BUFFER, total, nullptr, flags);
+        mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags);
+        if (!mapped) {
+            // Immutable storage cannot be respecified, so start over with a new name.
+            std::cout << "Persistent mapping failed, streaming with buffer orphaning" << std::endl;
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            persistent = false;
+        }
+    }
+    if (!persistent) {
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)frameBytes, nullptr, GL_STREAM_DRAW);
+        staging.resize(frameBytes);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void FrameRingBuffer::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    mapped = nullptr;
+    staging.clear();
+    used = flushed = 0;
+}
+
+void FrameRingBuffer::beginFrame() {
+    used = flushed = 0;
+    if (!persistent) return;
+
+    region = (region + 1) % RING_FRAMES;
+    GLsync& fence = fences[region];
+    if (!fence) return;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        // The GPU is RING_FRAMES frames behind; nothing to do but wait for it.
+        profilerAdd(PROF_RING_FENCE_WAITS);
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, RING_WAIT_TIMEOUT_NS) == GL_TIMEOUT_EXPIRED) {}
+    }
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+RingAllocation FrameRingBuffer::allocate(size_t bytes, size_t alignment) {
+    size_t base = persistent ? (size_t)region * frameBytes : 0;
+    size_t offset = (base + used + alignment - 1) / alignment * alignment;
+    if (offset + bytes > base + frameBytes) {
+        if (!overflowReported) {
+            std::cout << "Frame ring buffer full (" << frameBytes << " bytes per frame)" << std::endl;
+            overflowReported = true;
+        }
+        return { nullptr, 0 };
+    }
+    used = offset + bytes - base;
+    profilerAdd(PROF_RING_BYTES, (long long)bytes);
+    unsigned char* data = persistent ? mapped + offset : staging.data() + offset;
+    return { data, offset };
+}
+
+void FrameRingBuffer::flush() {
+    // Coherent persistent writes need no call at all.
+    if (persistent || used == flushed) return;
+    // Orphaning leaves draws issued earlier on the old storage, so everything
+    // this frame wrote goes up again, not just what is new.
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)frameBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)used, staging.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    flushed = used;
+}
+
+void FrameRingBuffer::endFrame() {
+    if (persistent) fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
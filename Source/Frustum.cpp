@@ -0,0 +1,83 @@
+#include "../Header/Frustum.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+const int FRUSTUM_PLANES = 6;
+
+AABB transformAABB(const AABB& box, const glm::mat4& model) {
+    AABB out;
+    for (int r = 0; r < 3; r++) {
+        out.min[r] = out.max[r] = model[3][r];
+        for (int c = 0; c < 3; c++) {
+            float a = model[c][r] * box.min[c];
+            float b = model[c][r] * box.max[c];
+            out.min[r] += a < b ? a : b;
+            out.max[r] += a < b ? b : a;
+        }
+    }
+    return out;
+}
+
+void Frustum::extract(const glm::mat4& m) {
+    // Gribb-Hartmann: each plane is row 3 of the matrix plus or minus another row.
+    for (int i = 0; i < FRUSTUM_PLANES; i++) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        float a = m[0][3] + sign * m[0][row];
+        float b = m[1][3] + sign * m[1][row];
+        float c = m[2][3] + sign * m[2][row];
+        float w = m[3][3] + sign * m[3][row];
+        float length = sqrtf(a * a + b * b + c * c);
+        if (length > 0.0f) {
+            a /= length;
+            b /= length;
+            c /= length;
+            w /= length;
+        }
+        nx[i] = a;
+        ny[i] = b;
+        nz[i] = c;
+        d[i] = w;
+    }
+    for (int i = FRUSTUM_PLANES; i < PLANE_SLOTS; i++) {
+        nx[i] = ny[i] = nz[i] = 0.0f;
+        d[i] = 1.0f;
+    }
+}
+
+bool Frustum::isVisible(const AABB& box) const {
+    // A box is outside when even its corner furthest along a plane normal is
+    // behind that plane. max(n*min, n*max) per axis picks that corner.
+#ifdef FRUSTUM_USE_SSE
+    __m128 minX = _mm_set1_ps(box.min.x), maxX = _mm_set1_ps(box.max.x);
+    __m128 minY = _mm_set1_ps(box.min.y), maxY = _mm_set1_ps(box.max.y);
+    __m128 minZ = _mm_set1_ps(box.min.z), maxZ = _mm_set1_ps(box.max.z);
+    __m128 zero = _mm_setzero_ps();
+
+    for (int i = 0; i < PLANE_SLOTS; i += 4) {
+        __m128 px = _mm_load_ps(nx + i);
+        __m128 py = _mm_load_ps(ny + i);
+        __m128 pz = _mm_load_ps(nz + i);
+        __m128 dist = _mm_load_ps(d + i);
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(px, minX), _mm_mul_ps(px, maxX)));
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(py, minY), _mm_mul_ps(py, maxY)));
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(pz, minZ), _mm_mul_ps(pz, maxZ)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(dist, zero))) return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < FRUSTUM_PLANES; i++) {
+        float dist = d[i];
+        dist += fmaxf(nx[i] * box.min.x, nx[i] * box.max.x);
+        dist += fmaxf(ny[i] * box.min.y, ny[i] * box.max.y);
+        dist += fmaxf(nz[i] * box.min.z, nz[i] * box.max.z);
+        if (dist < 0.0f) return false;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,183 @@
+#include "../Header/GLState.h"
+#include "../Header/Profiler.h"
+
+#include <iostream>
+
+const int STATE_UNKNOWN = -1;
+const int MAX_MISMATCH_LOGS = 16;
+
+GLStateCache glState;
+
+static const GLenum capEnums[] = { GL_CULL_FACE, GL_DEPTH_TEST, GL_BLEND };
+static const GLenum textureTargets[GL_STATE_TEXTURE_TARGETS] = {
+    GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER
+};
+static const GLenum textureBindingQueries[GL_STATE_TEXTURE_TARGETS] = {
+    GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_BUFFER
+};
+
+static int mismatchLogs = 0;
+
+GLStateCache::GLStateCache() : validation(false) {
+    invalidate();
+}
+
+void GLStateCache::invalidate() {
+    program = 0;
+    vao = 0;
+    activeUnit = STATE_UNKNOWN;
+    blendSrc = blendDst = GL_NONE;
+    programKnown = vaoKnown = blendKnown = false;
+    for (int t = 0; t < GL_STATE_TEXTURE_TARGETS; t++) {
+        for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+            textures[t][i] = 0;
+            texturesKnown[t][i] = false;
+        }
+    }
+    for (int i = 0; i < CAP_COUNT; i++) caps[i] = STATE_UNKNOWN;
+}
+
+void GLStateCache::reportMismatch(const char* what, long long shadow, long long actual) {
+    profilerAdd(PROF_GL_STATE_MISMATCHES);
+    if (mismatchLogs >= MAX_MISMATCH_LOGS) return;
+    mismatchLogs++;
+    std::cout << "GL state cache out of sync: " << what << " shadow=" << shadow
+              << " actual=" << actual << std::endl;
+}
+
+void GLStateCache::useProgram(GLuint newProgram) {
+    if (validation && programKnown) {
+        GLint actual = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &actual);
+        if ((GLuint)actual != program) reportMismatch("program", program, actual);
+    }
+    if (programKnown && program == newProgram) {
+        profilerAdd(PROF_GL_CALLS_ELIDED);
+        return;
+    }
+    glUseProgram(newProgram);
+    program = newProgram;
+    programKnown = true;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+void GLStateCache::bindVertexArray(GLuint newVao) {
+    if (validation && vaoKnown) {
+        GLint actual = 0;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &actual);
+        if ((GLuint)actual != vao) reportMismatch("vertex array", vao, actual);
+    }
+    if (vaoKnown && vao == newVao) {
+        profilerAdd(PROF_GL_CALLS_ELIDED);
+        return;
+    }
+    glBindVertexArray(newVao);
+    vao = newVao;
+    vaoKnown = true;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+void GLStateCache::activeTexture(int unit) {
+    if (validation && activeUnit != STATE_UNKNOWN) {
+        GLint actual = 0;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &actual);
+        if (actual != (GLint)(GL_TEXTURE0 + activeUnit)) reportMismatch("active texture", activeUnit, actual - GL_TEXTURE0);
+    }
+    if (activeUnit == unit) {
+        profilerAdd(PROF_GL_CALLS_ELIDED);
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    activeUnit = unit;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+void GLStateCache::bindTexture(int unit, GLuint texture, GLenum target) {
+    int t = targetIndex(target);
+    if (unit < 0 || unit >= GL_STATE_TEXTURE_UNITS || t < 0) return;
+
+    if (texturesKnown[t][unit] && textures[t][unit] == texture) {
+        if (validation) {
+            activeTexture(unit);
+            GLint actual = 0;
+            glGetIntegerv(textureBindingQueries[t], &actual);
+            if ((GLuint)actual != textures[t][unit]) reportMismatch("texture binding", textures[t][unit], actual);
+        }
+        profilerAdd(PROF_GL_CALLS_ELIDED);
+        return;
+    }
+
+    activeTexture(unit);
+    glBindTexture(target, texture);
+    textures[t][unit] = texture;
+    texturesKnown[t][unit] = true;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+int GLStateCache::targetIndex(GLenum target) const {
+    for (int i = 0; i < GL_STATE_TEXTURE_TARGETS; i++) {
+        if (textureTargets[i] == target) return i;
+    }
+    return -1;
+}
+
+int GLStateCache::capIndex(GLenum cap) const {
+    for (int i = 0; i < CAP_COUNT; i++) {
+        if (capEnums[i] == cap) return i;
+    }
+    return -1;
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled) {
+    int index = capIndex(cap);
+    if (index < 0) {
+        if (enabled) glEnable(cap);
+        else glDisable(cap);
+        return;
+    }
+
+    if (validation && caps[index] != STATE_UNKNOWN) {
+        int actual = glIsEnabled(cap) ? 1 : 0;
+        if (actual != caps[index]) reportMismatch("enable flag", caps[index], actual);
+    }
+    int value = enabled ? 1 : 0;
+    if (caps[index] == value) {
+        profilerAdd(PROF_GL_CALLS_ELIDED);
+        return;
+    }
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+    caps[index] = value;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst) {
+    if (validation && blendKnown) {
+        GLint actualSrc = 0, actualDst = 0;
+        glGetIntegerv(GL_BLEND_SRC_RGB, &actualSrc);
+        glGetIntegerv(GL_BLEND_DST_RGB, &actualDst);
+        if ((GLenum)actualSrc != blendSrc) reportMismatch("blend src", blendSrc, actualSrc);
+        if ((GLenum)actualDst != blendDst) reportMismatch("blend dst", blendDst, actualDst);
+    }
+    if (blendKnown && blendSrc == src && blendDst == dst) {
+        profilerAdd(PROF_GL_CALLS_ELIDED);
+        return;
+    }
+    glBlendFunc(src, dst);
+    blendSrc = src;
+    blendDst = dst;
+    blendKnown = true;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+void GLStateCache::forgetTexture(GLuint texture) {
+    for (int t = 0; t < GL_STATE_TEXTURE_TARGETS; t++) {
+        for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+            if (texturesKnown[t][i] && textures[t][i] == texture) textures[t][i] = 0;
+        }
+    }
+}
+
+void GLStateCache::forgetVertexArray(GLuint array) {
+    if (vaoKnown && vao == array) vao = 0;
+}
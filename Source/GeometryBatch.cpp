@@ -0,0 +1,128 @@
+#include "../Header/GeometryBatch.h"
+#include "../Header/GLState.h"
+
+#include <algorithm>
+#include <cstddef>
+
+const int SOURCE_STRIDE = 8;
+
+void attachBatchVertices(GLuint vao, GLuint buffer) {
+    glState.bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, normal));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(BATCH_COLOR_ATTRIB, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, color));
+    glEnableVertexAttribArray(BATCH_COLOR_ATTRIB);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+GeometryBatch::GeometryBatch() : vao(0), vbo(0) {}
+
+void GeometryBatch::clear() {
+    vertices.clear();
+}
+
+void GeometryBatch::addMesh(const float* source, int vertexCount, const glm::mat4& model, const glm::vec3& color) {
+    // Normals go through the cofactor matrix of the upper 3x3, which is the
+    // inverse-transpose up to a positive scale and survives non-uniform scaling.
+    glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+    glm::vec3 n0 = glm::cross(c1, c2);
+    glm::vec3 n1 = glm::cross(c2, c0);
+    glm::vec3 n2 = glm::cross(c0, c1);
+
+    for (int i = 0; i < vertexCount; i++) {
+        const float* v = source + i * SOURCE_STRIDE;
+        glm::vec4 p = model * glm::vec4(v[0], v[1], v[2], 1.0f);
+        glm::vec3 n = glm::normalize(n0 * v[3] + n1 * v[4] + n2 * v[5]);
+
+        BatchVertex out;
+        out.position[0] = p.x; out.position[1] = p.y; out.position[2] = p.z;
+        out.normal[0] = n.x;   out.normal[1] = n.y;   out.normal[2] = n.z;
+        out.color[0] = color.x; out.color[1] = color.y; out.color[2] = color.z;
+        vertices.push_back(out);
+    }
+}
+
+static BatchVertex midpoint(const BatchVertex& a, const BatchVertex& b) {
+    BatchVertex m;
+    for (int i = 0; i < 3; i++) {
+        m.position[i] = (a.position[i] + b.position[i]) * 0.5f;
+        m.normal[i] = (a.normal[i] + b.normal[i]) * 0.5f;
+        m.color[i] = (a.color[i] + b.color[i]) * 0.5f;
+    }
+    return m;
+}
+
+static float distanceSquared(const BatchVertex& a, const BatchVertex& b) {
+    float sum = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        float d = a.position[i] - b.position[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+static void splitTriangle(const BatchVertex& a, const BatchVertex& b, const BatchVertex& c, float maxEdge2,
+                          std::vector<BatchVertex>& out) {
+    float ab = distanceSquared(a, b), bc = distanceSquared(b, c), ca = distanceSquared(c, a);
+    float longest = std::max(ab, std::max(bc, ca));
+    if (longest <= maxEdge2) {
+        out.push_back(a);
+        out.push_back(b);
+        out.push_back(c);
+        return;
+    }
+    // Rotate so the longest edge is a-b; the halves keep the winding.
+    if (ab < longest) {
+        if (bc == longest) splitTriangle(b, c, a, maxEdge2, out);
+        else splitTriangle(c, a, b, maxEdge2, out);
+        return;
+    }
+    BatchVertex m = midpoint(a, b);
+    splitTriangle(a, m, c, maxEdge2, out);
+    splitTriangle(m, b, c, maxEdge2, out);
+}
+
+void GeometryBatch::subdivide(float maxEdge, const std::vector<BatchRange*>& ranges) {
+    int triangleCount = (int)vertices.size() / 3;
+    std::vector<int> newFirst(triangleCount + 1);
+    std::vector<BatchVertex> out;
+    out.reserve(vertices.size() * 4);
+    for (int t = 0; t < triangleCount; t++) {
+        newFirst[t] = (int)out.size();
+        splitTriangle(vertices[t * 3], vertices[t * 3 + 1], vertices[t * 3 + 2], maxEdge * maxEdge, out);
+    }
+    newFirst[triangleCount] = (int)out.size();
+
+    for (BatchRange* range : ranges) {
+        int first = newFirst[range->first / 3];
+        range->count = newFirst[(range->first + range->count) / 3] - first;
+        range->first = first;
+    }
+    vertices.swap(out);
+}
+
+void GeometryBatch::upload(GLenum usage) {
+    if (!vao) {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        attachBatchVertices(vao, vbo);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BatchVertex), vertices.data(), usage);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryBatch::destroy() {
+    if (vao) {
+        glState.forgetVertexArray(vao);
+        glDeleteVertexArrays(1, &vao);
+    }
+    if (vbo) glDeleteBuffers(1, &vbo);
+    vao = 0;
+    vbo = 0;
+    vertices.clear();
+}
@@ -0,0 +1,120 @@
+#include "../Header/InstanceBuffer.h"
+#include "../Header/Profiler.h"
+#include "../Header/GLState.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+const float UNIFORM_SCALE_TOLERANCE = 1e-4f;
+
+static bool isUniformScale(float sx, float sy, float sz) {
+    float largest = std::max(sx, std::max(sy, sz));
+    float smallest = std::min(sx, std::min(sy, sz));
+    return largest - smallest <= UNIFORM_SCALE_TOLERANCE * largest;
+}
+
+InstanceData makeInstanceData(const glm::mat4& model, const glm::vec3& color) {
+    InstanceData data;
+    for (int r = 0; r < 3; r++) {
+        data.modelRows[r] = glm::vec4(model[0][r], model[1][r], model[2][r], model[3][r]);
+    }
+    data.color = glm::vec4(color, 1.0f);
+
+    float sx = glm::dot(glm::vec3(model[0]), glm::vec3(model[0]));
+    float sy = glm::dot(glm::vec3(model[1]), glm::vec3(model[1]));
+    float sz = glm::dot(glm::vec3(model[2]), glm::vec3(model[2]));
+    if (isUniformScale(sx, sy, sz) || sx <= 0.0f || sy <= 0.0f || sz <= 0.0f) {
+        data.normalScale = glm::vec4(1.0f);
+    } else {
+        data.normalScale = glm::vec4(1.0f / sx, 1.0f / sy, 1.0f / sz, 1.0f);
+    }
+    return data;
+}
+
+glm::mat3 normalMatrix(const glm::mat4& model) {
+    glm::mat3 m(model);
+    if (isUniformScale(glm::dot(m[0], m[0]), glm::dot(m[1], m[1]), glm::dot(m[2], m[2]))) return m;
+
+    // The inverse transpose's columns are the cross products of the other two
+    // columns over the determinant.
+    glm::mat3 result;
+    result[0] = glm::cross(m[1], m[2]);
+    result[1] = glm::cross(m[2], m[0]);
+    result[2] = glm::cross(m[0], m[1]);
+    float det = glm::dot(m[0], result[0]);
+    if (fabsf(det) > 1e-12f) {
+        for (int c = 0; c < 3; c++) result[c] = result[c] / det;
+    }
+    return result;
+}
+
+void attachInstanceAttributes(GLuint vao, GLuint buffer, size_t firstInstance) {
+    glState.bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint i = 0; i < 4; i++) {
+        GLuint location = INSTANCE_ATTRIB_FIRST + i;
+        size_t offset = firstInstance * sizeof(InstanceData) + i * sizeof(glm::vec4);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offset);
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    size_t normalOffset = firstInstance * sizeof(InstanceData) + offsetof(InstanceData, normalScale);
+    glVertexAttribPointer(INSTANCE_NORMAL_ATTRIB, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)normalOffset);
+    glEnableVertexAttribArray(INSTANCE_NORMAL_ATTRIB);
+    glVertexAttribDivisor(INSTANCE_NORMAL_ATTRIB, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+InstanceBuffer::InstanceBuffer() : buffer(0), capacity(0) {}
+
+void InstanceBuffer::create(size_t initialCapacity) {
+    destroy();
+    capacity = initialCapacity > 0 ? initialCapacity : 1;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::destroy() {
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    capacity = 0;
+}
+
+void InstanceBuffer::attach(GLuint vao, size_t firstInstance) const {
+    attachInstanceAttributes(vao, buffer, firstInstance);
+}
+
+void InstanceBuffer::upload(const InstanceData* instances, size_t first, size_t count) {
+    if (count == 0) return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if (first + count > capacity) {
+        // Grow geometrically. Whatever was already uploaded below `first` is
+        // parked in a scratch buffer and copied back on the GPU, so the buffer
+        // keeps its name without a readback.
+        size_t newCapacity = capacity;
+        while (newCapacity < first + count) newCapacity *= 2;
+        GLsizeiptr keepBytes = (GLsizeiptr)(first * sizeof(InstanceData));
+        GLuint scratch = 0;
+        if (keepBytes > 0) {
+            glGenBuffers(1, &scratch);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+            glBufferData(GL_COPY_WRITE_BUFFER, keepBytes, nullptr, GL_STREAM_COPY);
+            glCopyBufferSubData(GL_ARRAY_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, keepBytes);
+        }
+        glBufferData(GL_ARRAY_BUFFER, newCapacity * sizeof(InstanceData), nullptr, GL_DYNAMIC_DRAW);
+        if (scratch) {
+            glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_ARRAY_BUFFER, 0, 0, keepBytes);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &scratch);
+        }
+        capacity = newCapacity;
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(InstanceData), count * sizeof(InstanceData), instances);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    profilerAdd(PROF_INSTANCE_UPLOAD_BYTES, (long long)(count * sizeof(InstanceData)));
+}
@@ -0,0 +1,98 @@
+#include "../Header/JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem() : quit(false) {}
+
+JobSystem::~JobSystem() {
+    shutdown();
+}
+
+void JobSystem::start(int threads) {
+    if (!workers.empty()) return;
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency() - 1;
+    quit = false;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread(&JobSystem::workerLoop, this));
+    }
+}
+
+void JobSystem::shutdown() {
+    if (workers.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+}
+
+void JobSystem::run(JobGroup& group, const std::function<void()>& job) {
+    if (workers.empty()) {
+        job();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({ job, &group });
+        group.pending++;
+    }
+    wake.notify_one();
+    // Threads blocked in wait() pick up jobs too, which matters when every
+    // worker is itself waiting inside a job.
+    done.notify_all();
+}
+
+void JobSystem::wait(JobGroup& group) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (group.pending > 0) {
+        if (!queue.empty()) {
+            runFront(lock);
+        } else {
+            done.wait(lock);
+        }
+    }
+}
+
+void JobSystem::parallelFor(int count, int minChunk, const std::function<void(int, int)>& job) {
+    if (count <= 0) return;
+    int chunks = (int)workers.size() + 1;
+    if (minChunk < 1) minChunk = 1;
+    if (count / minChunk < chunks) chunks = count / minChunk;
+    if (chunks <= 1) {
+        job(0, count);
+        return;
+    }
+
+    JobGroup group;
+    int chunkSize = (count + chunks - 1) / chunks;
+    // The caller takes the first chunk rather than queueing it.
+    for (int begin = chunkSize; begin < count; begin += chunkSize) {
+        int end = std::min(begin + chunkSize, count);
+        run(group, [&job, begin, end] { job(begin, end); });
+    }
+    job(0, chunkSize);
+    wait(group);
+}
+
+void JobSystem::runFront(std::unique_lock<std::mutex>& lock) {
+    Job job = queue.front();
+    queue.pop_front();
+    lock.unlock();
+
+    job.function();
+
+    lock.lock();
+    job.group->pending--;
+    if (job.group->pending == 0) done.notify_all();
+}
+
+void JobSystem::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return !queue.empty() || quit; });
+        if (quit) return;
+        runFront(lock);
+    }
+}
@@ -0,0 +1,432 @@
+#include "../Header/LightBaker.h"
+#include "../Header/GLState.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+const char* const LIGHT_CACHE_DIR = "Cache/lighting";
+const uint32_t LIGHT_CACHE_MAGIC = 0x314B4C42; // "BLK1"
+// Part of the cache key; bump it whenever bakePoint changes what it computes
+// (sampling, the single diffuse bounce, how the terms are combined).
+const uint32_t LIGHT_BAKE_VERSION = 1;
+const int BVH_LEAF_SIZE = 4;
+const float RAY_OFFSET = 0.002f;
+// Must match the main light terms in basic.frag.
+const float AMBIENT_STRENGTH = 0.35f;
+const float WRAP_AMOUNT = 0.3f;
+
+struct LightCacheHeader {
+    uint32_t magic;
+    uint32_t vertexCount;
+};
+
+struct BakeTriangle {
+    glm::vec3 v0, edge1, edge2;
+    glm::vec3 normal;
+    glm::vec3 albedo;
+};
+
+struct BvhNode {
+    glm::vec3 boundsMin, boundsMax;
+    int start;      // leaf: first triangle; inner: right child (the left child follows the node)
+    int count;      // triangles in a leaf, 0 for inner nodes
+};
+
+static glm::vec3 minVec(const glm::vec3& a, const glm::vec3& b) {
+    return glm::vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+static glm::vec3 maxVec(const glm::vec3& a, const glm::vec3& b) {
+    return glm::vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+// Triangles in a bounding volume hierarchy with median splits, enough for the
+// few thousand boxes a hall is built from.
+class BakeScene {
+public:
+    void build(const std::vector<BatchVertex>& receivers, const std::vector<BatchVertex>& occluders);
+
+    // Closest hit along the ray; returns the triangle index or -1.
+    int intersect(const glm::vec3& origin, const glm::vec3& dir, float& hitDistance) const;
+    bool occluded(const glm::vec3& origin, const glm::vec3& dir, float maxDistance) const;
+
+    const BakeTriangle& triangle(int index) const { return triangles[index]; }
+    int size() const { return (int)triangles.size(); }
+
+private:
+    void addTriangles(const std::vector<BatchVertex>& vertices);
+    int buildNode(int start, int count, std::vector<int>& order, const std::vector<glm::vec3>& centroids);
+    template <bool AnyHit>
+    int traverse(const glm::vec3& origin, const glm::vec3& dir, float& tMax) const;
+
+    std::vector<BakeTriangle> triangles;
+    std::vector<BvhNode> nodes;
+};
+
+void BakeScene::addTriangles(const std::vector<BatchVertex>& vertices) {
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        glm::vec3 p[3];
+        for (int k = 0; k < 3; k++) {
+            const float* v = vertices[i + k].position;
+            p[k] = glm::vec3(v[0], v[1], v[2]);
+        }
+        BakeTriangle tri;
+        tri.v0 = p[0];
+        tri.edge1 = p[1] - p[0];
+        tri.edge2 = p[2] - p[0];
+        glm::vec3 n = glm::cross(tri.edge1, tri.edge2);
+        if (glm::dot(n, n) <= 1e-12f) continue;
+        tri.normal = glm::normalize(n);
+        const float* c = vertices[i].color;
+        tri.albedo = glm::vec3(c[0], c[1], c[2]);
+        triangles.push_back(tri);
+    }
+}
+
+void BakeScene::build(const std::vector<BatchVertex>& receivers, const std::vector<BatchVertex>& occluders) {
+    triangles.clear();
+    nodes.clear();
+    addTriangles(receivers);
+    addTriangles(occluders);
+    if (triangles.empty()) return;
+
+    std::vector<glm::vec3> centroids(triangles.size());
+    std::vector<int> order(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const BakeTriangle& t = triangles[i];
+        centroids[i] = t.v0 + (t.edge1 + t.edge2) * (1.0f / 3.0f);
+        order[i] = (int)i;
+    }
+    nodes.reserve(triangles.size() * 2 / BVH_LEAF_SIZE + 1);
+    buildNode(0, (int)triangles.size(), order, centroids);
+
+    std::vector<BakeTriangle> sorted(triangles.size());
+    for (size_t i = 0; i < order.size(); i++) sorted[i] = triangles[order[i]];
+    triangles.swap(sorted);
+}
+
+int BakeScene::buildNode(int start, int count, std::vector<int>& order, const std::vector<glm::vec3>& centroids) {
+    int index = (int)nodes.size();
+    nodes.push_back(BvhNode());
+
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+    glm::vec3 centroidMin(1e30f), centroidMax(-1e30f);
+    for (int i = start; i < start + count; i++) {
+        const BakeTriangle& t = triangles[order[i]];
+        glm::vec3 corners[3] = { t.v0, t.v0 + t.edge1, t.v0 + t.edge2 };
+        for (const glm::vec3& c : corners) {
+            boundsMin = minVec(boundsMin, c);
+            boundsMax = maxVec(boundsMax, c);
+        }
+        centroidMin = minVec(centroidMin, centroids[order[i]]);
+        centroidMax = maxVec(centroidMax, centroids[order[i]]);
+    }
+    nodes[index].boundsMin = boundsMin;
+    nodes[index].boundsMax = boundsMax;
+
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    if (count <= BVH_LEAF_SIZE || extent[axis] <= 0.0f) {
+        nodes[index].start = start;
+        nodes[index].count = count;
+        return index;
+    }
+
+    int half = count / 2;
+    std::nth_element(order.begin() + start, order.begin() + start + half, order.begin() + start + count,
+                     [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+    buildNode(start, half, order, centroids);
+    int right = buildNode(start + half, count - half, order, centroids);
+    nodes[index].start = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+static bool hitBounds(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax) {
+    float tNear = 0.0f, tFar = tMax;
+    for (int a = 0; a < 3; a++) {
+        float t0 = (node.boundsMin[a] - origin[a]) * invDir[a];
+        float t1 = (node.boundsMax[a] - origin[a]) * invDir[a];
+        if (t0 > t1) std::swap(t0, t1);
+        tNear = std::max(tNear, t0);
+        tFar = std::min(tFar, t1);
+        if (tNear > tFar) return false;
+    }
+    return true;
+}
+
+// Moller-Trumbore, both faces.
+static bool hitTriangle(const BakeTriangle& t, const glm::vec3& origin, const glm::vec3& dir, float& distance) {
+    glm::vec3 p = glm::cross(dir, t.edge2);
+    float det = glm::dot(t.edge1, p);
+    if (fabsf(det) < 1e-9f) return false;
+    float invDet = 1.0f / det;
+    glm::vec3 s = origin - t.v0;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s, t.edge1);
+    float v = glm::dot(dir, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    float d = glm::dot(t.edge2, q) * invDet;
+    if (d <= 0.0f || d >= distance) return false;
+    distance = d;
+    return true;
+}
+
+template <bool AnyHit>
+int BakeScene::traverse(const glm::vec3& origin, const glm::vec3& dir, float& tMax) const {
+    if (nodes.empty()) return -1;
+    glm::vec3 invDir(1.0f / (dir.x != 0.0f ? dir.x : 1e-20f),
+                     1.0f / (dir.y != 0.0f ? dir.y : 1e-20f),
+                     1.0f / (dir.z != 0.0f ? dir.z : 1e-20f));
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    int hit = -1;
+    while (top > 0) {
+        int index = stack[--top];
+        const BvhNode& node = nodes[index];
+        if (!hitBounds(node, origin, invDir, tMax)) continue;
+        if (node.count > 0) {
+            for (int i = node.start; i < node.start + node.count; i++) {
+                if (hitTriangle(triangles[i], origin, dir, tMax)) {
+                    hit = i;
+                    if (AnyHit) return hit;
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.start;
+        stack[top++] = index + 1;
+    }
+    return hit;
+}
+
+int BakeScene::intersect(const glm::vec3& origin, const glm::vec3& dir, float& hitDistance) const {
+    hitDistance = 1e30f;
+    return traverse<false>(origin, dir, hitDistance);
+}
+
+bool BakeScene::occluded(const glm::vec3& origin, const glm::vec3& dir, float maxDistance) const {
+    return traverse<true>(origin, dir, maxDistance) >= 0;
+}
+
+// Small per-point generator so the bake does not depend on thread scheduling.
+struct BakeRandom {
+    uint32_t state;
+    explicit BakeRandom(uint32_t seed) : state(seed * 747796405u + 2891336453u) {}
+    float next() {
+        state = state * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (float)(((word >> 22u) ^ word) >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+// The unshadowed main light term from basic.frag, for a unit white light.
+static float lightTerm(const glm::vec3& normal, const glm::vec3& toLight) {
+    float ndl = glm::dot(normal, toLight);
+    float diff = std::max(ndl, 0.0f);
+    float wrapDiff = std::max(ndl * 0.5f + 0.5f, 0.0f);
+    return diff + (wrapDiff - diff) * WRAP_AMOUNT;
+}
+
+static float directLight(const BakeScene& scene, const glm::vec3& position, const glm::vec3& normal,
+                         const glm::vec3& light) {
+    glm::vec3 toLight = light - position;
+    float distance = glm::length(toLight);
+    if (distance <= 0.0f) return 0.0f;
+    toLight = toLight / distance;
+    float term = lightTerm(normal, toLight);
+    if (term <= 0.0f) return 0.0f;
+    glm::vec3 origin = position + normal * RAY_OFFSET;
+    return scene.occluded(origin, toLight, distance) ? 0.0f : term;
+}
+
+static void bakePoint(const BakeScene& scene, const glm::vec3& position, const glm::vec3& normal,
+                      const glm::vec3* lights, const BakeSettings& settings, uint32_t seed, glm::vec4* out) {
+    // Orthonormal basis around the normal for the hemisphere rays.
+    glm::vec3 helper = fabsf(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+    glm::vec3 origin = position + normal * RAY_OFFSET;
+
+    BakeRandom random(seed);
+    float open = 0.0f;
+    glm::vec3 bounce[BAKED_LIGHT_COUNT];
+    for (int s = 0; s < settings.samples; s++) {
+        // Cosine-weighted, so the plain average of the hits is the irradiance.
+        float u = random.next(), v = random.next();
+        float r = sqrtf(u);
+        float phi = 6.2831853f * v;
+        glm::vec3 dir = tangent * (r * cosf(phi)) + bitangent * (r * sinf(phi)) + normal * sqrtf(std::max(1.0f - u, 0.0f));
+
+        float distance;
+        int hit = scene.intersect(origin, dir, distance);
+        if (hit < 0 || distance > settings.aoDistance) open += 1.0f;
+        if (hit < 0) continue;
+
+        const BakeTriangle& tri = scene.triangle(hit);
+        glm::vec3 hitNormal = glm::dot(tri.normal, dir) < 0.0f ? tri.normal : -tri.normal;
+        glm::vec3 hitPos = origin + dir * distance;
+        for (int l = 0; l < BAKED_LIGHT_COUNT; l++) {
+            bounce[l] += tri.albedo * directLight(scene, hitPos, hitNormal, lights[l]);
+        }
+    }
+
+    float invSamples = 1.0f / (float)std::max(settings.samples, 1);
+    float ambient = AMBIENT_STRENGTH * open * invSamples;
+    for (int l = 0; l < BAKED_LIGHT_COUNT; l++) {
+        float direct = directLight(scene, position, normal, lights[l]);
+        glm::vec3 total = glm::vec3(ambient + direct) + bounce[l] * invSamples;
+        float brightest = std::max(total.x, std::max(total.y, total.z));
+        out[l] = glm::vec4(total, brightest > 0.0f ? std::min(direct / brightest, 1.0f) : 0.0f);
+    }
+}
+
+static uint64_t hashBytes(uint64_t hash, const void* bytes, size_t size) {
+    const unsigned char* p = (const unsigned char*)bytes;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+LightBaker::LightBaker() : buffer(0) {}
+
+bool LightBaker::readCache(const std::string& file, size_t vertexCount) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    LightCacheHeader header;
+    if (!in.read((char*)&header, sizeof(header))) return false;
+    if (header.magic != LIGHT_CACHE_MAGIC || header.vertexCount != vertexCount) return false;
+
+    data.resize(vertexCount * BAKED_LIGHT_COUNT);
+    return (bool)in.read((char*)data.data(), data.size() * sizeof(glm::vec4));
+}
+
+void LightBaker::writeCache(const std::string& file) const {
+    std::error_code ec;
+    fs::create_directories(LIGHT_CACHE_DIR, ec);
+
+    std::ofstream out(file, std::ios::binary);
+    if (!out.is_open()) return;
+
+    LightCacheHeader header;
+    header.magic = LIGHT_CACHE_MAGIC;
+    header.vertexCount = (uint32_t)(data.size() / BAKED_LIGHT_COUNT);
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)data.data(), data.size() * sizeof(glm::vec4));
+}
+
+void LightBaker::bake(const std::vector<BatchVertex>& receivers, const std::vector<BatchVertex>& occluders,
+                      const glm::vec3 lightPositions[BAKED_LIGHT_COUNT], const BakeSettings& settings) {
+    uint64_t hash = 1469598103934665603ull;
+    hash = hashBytes(hash, &LIGHT_BAKE_VERSION, sizeof(LIGHT_BAKE_VERSION));
+    hash = hashBytes(hash, &BAKED_LIGHT_COUNT, sizeof(BAKED_LIGHT_COUNT));
+    hash = hashBytes(hash, &AMBIENT_STRENGTH, sizeof(AMBIENT_STRENGTH));
+    hash = hashBytes(hash, &WRAP_AMOUNT, sizeof(WRAP_AMOUNT));
+    hash = hashBytes(hash, &RAY_OFFSET, sizeof(RAY_OFFSET));
+    hash = hashBytes(hash, receivers.data(), receivers.size() * sizeof(BatchVertex));
+    hash = hashBytes(hash, occluders.data(), occluders.size() * sizeof(BatchVertex));
+    hash = hashBytes(hash, lightPositions, BAKED_LIGHT_COUNT * sizeof(glm::vec3));
+    hash = hashBytes(hash, &settings.samples, sizeof(settings.samples));
+    hash = hashBytes(hash, &settings.aoDistance, sizeof(settings.aoDistance));
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    std::string cacheFile = std::string(LIGHT_CACHE_DIR) + "/" + name;
+    if (readCache(cacheFile, receivers.size())) {
+        std::cout << "Light bake: " << receivers.size() << " vertices loaded from " << cacheFile << std::endl;
+        return;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    BakeScene scene;
+    scene.build(receivers, occluders);
+
+    // Triangles are stored unindexed, so most positions repeat; each distinct
+    // position/normal pair is traced once.
+    std::vector<int> pointOf(receivers.size());
+    std::vector<int> firstVertex;
+    std::unordered_map<std::string, int> lookup;
+    lookup.reserve(receivers.size());
+    for (size_t i = 0; i < receivers.size(); i++) {
+        std::string key((const char*)receivers[i].position, sizeof(float) * 6);
+        auto it = lookup.find(key);
+        if (it == lookup.end()) {
+            it = lookup.emplace(key, (int)firstVertex.size()).first;
+            firstVertex.push_back((int)i);
+        }
+        pointOf[i] = it->second;
+    }
+
+    std::vector<glm::vec4> points(firstVertex.size() * BAKED_LIGHT_COUNT);
+    std::atomic<int> nextPoint(0);
+    const int chunk = 64;
+    auto worker = [&]() {
+        for (;;) {
+            int begin = nextPoint.fetch_add(chunk);
+            if (begin >= (int)firstVertex.size()) break;
+            int end = std::min(begin + chunk, (int)firstVertex.size());
+            for (int p = begin; p < end; p++) {
+                const BatchVertex& v = receivers[firstVertex[p]];
+                glm::vec3 position(v.position[0], v.position[1], v.position[2]);
+                glm::vec3 normal = glm::normalize(glm::vec3(v.normal[0], v.normal[1], v.normal[2]));
+                bakePoint(scene, position, normal, lightPositions, settings, (uint32_t)p,
+                          &points[(size_t)p * BAKED_LIGHT_COUNT]);
+            }
+        }
+    };
+
+    int threadCount = settings.threads > 0 ? settings.threads : (int)std::thread::hardware_concurrency();
+    threadCount = std::max(threadCount, 1);
+    std::vector<std::thread> threads;
+    for (int t = 1; t < threadCount; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads) thread.join();
+
+    data.resize(receivers.size() * BAKED_LIGHT_COUNT);
+    for (size_t i = 0; i < receivers.size(); i++) {
+        for (int l = 0; l < BAKED_LIGHT_COUNT; l++) {
+            data[i * BAKED_LIGHT_COUNT + l] = points[(size_t)pointOf[i] * BAKED_LIGHT_COUNT + l];
+        }
+    }
+    writeCache(cacheFile);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Light bake: " << firstVertex.size() << " points (" << receivers.size() << " vertices) against "
+              << scene.size() << " triangles, " << settings.samples << " samples, " << threadCount
+              << " threads, " << (int)ms << " ms" << std::endl;
+}
+
+void LightBaker::attach(GLuint vao) {
+    if (!buffer) glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(glm::vec4), data.data(), GL_STATIC_DRAW);
+
+    glState.bindVertexArray(vao);
+    GLsizei stride = (GLsizei)(sizeof(glm::vec4) * BAKED_LIGHT_COUNT);
+    for (int l = 0; l < BAKED_LIGHT_COUNT; l++) {
+        glVertexAttribPointer(BAKED_LIGHT_ATTRIB_FIRST + l, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(l * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(BAKED_LIGHT_ATTRIB_FIRST + l);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LightBaker::destroy() {
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    data.clear();
+}
@@ -11,16 +11,50 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstring>
 
 #include "../Header/Util.h"
 #include "../Header/glm/glm.hpp"
 #include "../Header/Camera.h"
+#include "../Header/Profiler.h"
+#include "../Header/TextureResidency.h"
+#include "../Header/TextureImport.h"
+#include "../Header/ShaderProgram.h"
+#include "../Header/InstanceBuffer.h"
+#include "../Header/GeometryBatch.h"
+#include "../Header/RenderQueue.h"
+#include "../Header/GLState.h"
+#include "../Header/Frustum.h"
+#include "../Header/OcclusionCulling.h"
+#include "../Header/MeshBuffer.h"
+#include "../Header/ClusteredLighting.h"
+#include "../Header/ShadowMap.h"
+#include "../Header/LightBaker.h"
+#include "../Header/TripleBuffer.h"
+#include "../Header/SpscQueue.h"
+#include "../Header/JobSystem.h"
+#include "../Header/FrameRingBuffer.h"
+#include "../Header/DynamicResolution.h"
 
 const int ROWS = 5;
 const int COLS = 10;
 const int TOTAL_SEATS = ROWS * COLS;
 const float TARGET_FPS = 75.0f;
 const float FRAME_TIME = 1.0f / TARGET_FPS;
+// The simulation advances in fixed steps independent of the render rate and
+// catches up with at most MAX_SIM_STEPS per frame; a longer stall is dropped
+// instead of replayed.
+const float SIM_TIMESTEP = 1.0f / 60.0f;
+const int MAX_SIM_STEPS = 8;
+const double MAX_FRAME_DELTA = 0.25;
+const double FRAME_REPORT_INTERVAL = 5.0;
+// Longest single glfwWaitEventsTimeout while nothing changes, and how often
+// the idle utilization is reported.
+const double IDLE_MAX_WAIT = 0.5;
+const double IDLE_REPORT_INTERVAL = 5.0;
 
 const float ROOM_WIDTH = 24.0f;
 const float ROOM_DEPTH = 18.0f;
@@ -41,12 +75,46 @@ const float SCREEN_HEIGHT = 7.0f;
 const int MAX_FRAME_TEXTURES = 25;
 const float FRAME_SWITCH_TIME = 0.5f;
 const float MOVIE_DURATION = 20.0f;
+// Scale from the shown frame's mean colour to the projector light and to the
+// light spilling off the screen.
+const float MOVIE_LIGHT_STRENGTH = 0.9f;
+const float SCREEN_SPILL_STRENGTH = 0.6f;
 
 const int NUM_HUMANOID_TYPES = 15;
 
+const size_t TEXTURE_VRAM_BUDGET = 256u * 1024u * 1024u;
+const float NEAREST_VIEW_DISTANCE = SEAT_SPACING_Z;
+const int MIN_IMPORT_TEXTURE_SIZE = 64;
+
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+const int SHADOW_MAP_SIZE = 2048;
+const float SHADOW_DEPTH_BIAS = 0.0005f;
+
+const glm::vec3 PROJECTOR_LIGHT_POS(0.0f, ROOM_HEIGHT / 2.0f - 1.0f, -ROOM_DEPTH / 2.0f + 1.5f);
+// Static batch faces are split to this edge length so per-vertex baked
+// lighting can resolve shadows and occlusion across walls and floor.
+const float BAKE_MAX_EDGE = 0.75f;
+const BakeSettings BAKE_SETTINGS = { 64, 1.5f, 0 };
+
 const glm::vec3 DOOR_POSITION(-ROOM_WIDTH / 2.0f + 1.5f, 0.0f, -ROOM_DEPTH / 2.0f + 0.5f);
 
 enum SeatStatus { FREE, RESERVED, BOUGHT };
+enum BasicShaderFeature {
+    BASIC_FEATURE_LIGHTING = 1,
+    BASIC_FEATURE_TEXTURE = 2,
+    BASIC_FEATURE_INSTANCED = 4,
+    BASIC_FEATURE_VERTEX_COLOR = 8,
+    BASIC_FEATURE_MATERIAL_ARRAY = 16,
+    BASIC_FEATURE_BAKED_LIGHTING = 32,
+    BASIC_VARIANT_COUNT = 64
+};
+const int MATERIAL_TEXTURE_UNIT = 1;
+// The uber shader still branches on lighting/texture at runtime, but needs one
+// program per vertex input layout (the feature bits above these two).
+const int BASIC_GEOMETRY_SHIFT = 2;
+const int BASIC_UBER_COUNT = BASIC_VARIANT_COUNT >> BASIC_GEOMETRY_SHIFT;
 enum AppState { WAITING, ENTERING, MOVIE, LEAVING };
 enum PersonState { WALKING_TO_AISLE, WALKING_IN_AISLE, WALKING_TO_SEAT, SEATED, WALKING_FROM_SEAT, WALKING_OUT_AISLE, EXITING, EXITED };
 
@@ -60,15 +128,26 @@ struct Seat {
     Seat(glm::vec3 pos, int r, int c) : position(pos), status(FREE), row(r), col(c), hasOccupant(false) {}
 };
 
+// One material group as parsed from the OBJ. Groups stay on the CPU until
+// uploadModel merges them into the model's single draw.
 struct ModelMesh {
-    GLuint VAO, VBO;
-    int vertexCount;
-    GLuint diffuseTexture;
+    std::vector<float> vertices;    // position/normal/texcoord triangles
+    std::string texturePath;
+    int textureMaxDimension;
     glm::vec3 diffuseColor;
 };
 
+// Indices of the model whose textured groups all sample one texture array.
+struct MaterialRange {
+    GLuint textures;        // GL_TEXTURE_2D_ARRAY, 0 when the model has no textures
+    uint32_t firstIndex;    // relative to the model's geometry
+    uint32_t indexCount;
+};
+
 struct Model3D {
     std::vector<ModelMesh> meshes;
+    MeshAllocation geometry;
+    std::vector<MaterialRange> materials;   // one per texture size, so usually one
     glm::vec3 boundsMin, boundsMax;
     float normalizeScale;
     glm::vec3 centerOffset;
@@ -86,10 +165,49 @@ struct Person {
     float walkCycle;
     float facingAngle;
     bool active;
+    // State before the last simulation step, blended with the current one
+    // when rendering between steps.
+    glm::vec3 previousPosition;
+    float previousFacingAngle;
 
     Person() : position(0.0f), currentTarget(0.0f), currentWaypointIndex(0),
                assignedSeatIndex(-1), humanoidType(0), state(WALKING_TO_AISLE),
-               entryDelay(0.0f), walkCycle(0.0f), facingAngle(0.0f), active(false) {}
+               entryDelay(0.0f), walkCycle(0.0f), facingAngle(0.0f), active(false),
+               previousPosition(0.0f), previousFacingAngle(0.0f) {}
+};
+
+// What the renderer needs of a person; waypoints and timers stay with the
+// simulation.
+struct PersonSnapshot {
+    glm::vec3 position, previousPosition;
+    float facingAngle, previousFacingAngle;
+    float walkCycle;
+    int humanoidType;
+    PersonState state;
+    bool active;
+};
+
+// Render-relevant simulation state after a step, published by the simulation
+// thread and never modified once published. It also holds the step before,
+// so the renderer can interpolate between the two.
+struct SimSnapshot {
+    std::vector<PersonSnapshot> people;
+    SeatStatus seatStatus[TOTAL_SEATS];
+    AppState state;
+    float doorOpenAmount, previousDoorOpenAmount;
+    bool roomLightOn;
+    int frameIndex;
+    double stepTime;                // glfwGetTime() the latest step corresponds to
+    long long steps;                // totals since startup
+    long long droppedSteps;
+    unsigned int commandsApplied;
+};
+
+// Input that changes simulation state, queued by the GLFW callbacks.
+enum SimCommandType { SIM_TOGGLE_SEAT, SIM_BUY_SEATS, SIM_START_SHOW };
+struct SimCommand {
+    SimCommandType type;
+    int value;
 };
 
 std::vector<Seat> seats;
@@ -106,6 +224,21 @@ bool depthTestEnabled = true;
 bool cullingEnabled = true;
 
 float doorOpenAmount = 0.0f;
+float previousDoorOpenAmount = 0.0f;
+
+// The simulation thread owns seat status, people, the door, the movie clock
+// and the state above. The GL thread sees them only through the latest
+// snapshot and changes them only by queueing commands, so neither waits on
+// the other and a frame costs max(simulation, render) instead of the sum.
+std::thread simThread;
+std::atomic<bool> simRunning(false);
+TripleBuffer<SimSnapshot> simSnapshots;
+SpscQueue<SimCommand, 64> simCommands;
+unsigned int simCommandsPosted = 0;     // GL thread
+unsigned int simCommandsApplied = 0;    // simulation thread
+long long simSteps = 0;
+long long simDroppedSteps = 0;
+const SimSnapshot* frameSnapshot = nullptr;
 bool doorOpening = false;
 bool doorClosing = false;
 const float DOOR_SPEED = 1.5f;
@@ -115,55 +248,255 @@ float lastX = 400.0f;
 float lastY = 400.0f;
 bool firstMouse = true;
 
+// Change tracking for skipping frames: a hash of the camera, seats, people,
+// door and movie state as the next frame would draw them (interpolated); a
+// frame is rendered only when it differs from the rendered one or something
+// else asked for a redraw.
+uint64_t renderedSignature = 0;
+bool redrawRequested = true;
+
+// What the loop did since the last idle report.
+struct IdleStats {
+    double start;
+    double cpuStart;
+    double waited;
+    long long gpuUs;
+    int renderedFrames;
+    int skippedFrames;
+};
+IdleStats idleStats;
+
+// How far the render time is between the previous and the current simulation
+// step, 0..1.
+float simAlpha = 1.0f;
+
+enum FrameCap {
+    FRAME_CAP_SLEEP,        // sleep-precise to TARGET_FPS
+    FRAME_CAP_VSYNC,
+    FRAME_CAP_UNCAPPED,
+    FRAME_CAP_COUNT
+};
+const char* FRAME_CAP_NAMES[FRAME_CAP_COUNT] = { "sleep", "vsync", "uncapped" };
+FrameCap frameCap = FRAME_CAP_SLEEP;
+
+// Durations of the rendered frames since the last report, for percentiles.
+struct FrameTimeStats {
+    double start;
+    std::vector<float> frameMs;
+    long long simStepsStart;
+    long long droppedStepsStart;
+};
+FrameTimeStats frameTimeStats;
+
+// The 3D scene renders at a scale of the window size that follows GPU frame
+// time; overlays stay native. The default target leaves a tenth of FRAME_TIME
+// for the rest of the frame. Settable with --resolution-target=<ms>,
+// --resolution-min=<scale> and --resolution-max=<scale>.
+DynamicResolutionSettings resolutionSettings = { FRAME_TIME * 1000.0f * 0.9f, 0.5f, 1.0f };
+DynamicResolution sceneResolution;
+long long resolutionGpuSample = 0;
+
 glm::vec3 mainLightPos(0.0f, ROOM_HEIGHT - 2.0f, 0.0f);
 glm::vec3 lightColor(1.0f, 0.95f, 0.9f);
 bool roomLightOn = true;
 
-unsigned int basicShader = 0;
-unsigned int screenShader = 0;
-unsigned int overlayShader = 0;
+ShaderProgram basicUberShaders[BASIC_UBER_COUNT];
+ShaderProgram basicVariants[BASIC_VARIANT_COUNT];
+bool shaderVariantsEnabled = true;
+// Debug/benchmark switch back to inverting the model matrix in basic.vert.
+bool perVertexNormalMatrices = false;
+ShaderProgram screenShader;
+ShaderProgram overlayShader;
 
 unsigned int cubeVAO = 0, cubeVBO = 0;
 unsigned int quadVAO = 0, quadVBO = 0;
 unsigned int overlayVAO = 0, overlayVBO = 0;
 
+// Everything that changes from frame to frame (instances, the dynamic batch's
+// vertices, FrameData) is written into this ring; see FrameRingBuffer.
+const size_t FRAME_RING_BYTES = 1 << 20;
+FrameRingBuffer frameRing;
+
+const int SEAT_PARTS = 5;
+unsigned int seatVAO = 0;
+// Status each seat's instances were last built with.
+std::vector<SeatStatus> builtSeatStatus;
+// CPU copy of every seat's instances; the visible seats' are packed into
+// visibleSeatInstances and streamed every frame.
+std::vector<InstanceData> seatInstanceData;
+std::vector<InstanceData> visibleSeatInstances;
+std::vector<int> visibleSeats;
+std::vector<int> packedSeats;
+
+// Every imported mesh lives in one shared vertex/index buffer and VAO.
+const uint32_t MODEL_BUFFER_VERTICES = 1 << 18;
+const uint32_t MODEL_BUFFER_INDICES = 1 << 20;
+MeshBuffer modelMeshes;
+
+// Visible people, grouped by humanoid type and packed into one ring
+// allocation read by the shared model VAO; each type's draws start at its own
+// base instance.
+std::vector<std::vector<InstanceData>> crowdInstanceData;
+std::vector<InstanceData> crowdPacked;
+std::vector<float> crowdNearestDepth;
+
+// Per-person transform, culling result and instance data, filled on job
+// threads by preparePeople and packed per model by renderPeople.
+enum PersonVisibility { PERSON_ABSENT, PERSON_CULLED, PERSON_OCCLUDED, PERSON_VISIBLE };
+struct PreparedPerson {
+    PersonVisibility visibility;
+    int type;
+    float depth;
+    InstanceData instance;
+};
+std::vector<PreparedPerson> preparedPeople;
+const int PEOPLE_JOB_CHUNK = 32;
+
+// Worker threads for the CPU side of each frame; see prepareScene.
+JobSystem frameJobs;
+
+Frustum viewFrustum;
+OcclusionCuller occlusionCuller;
+bool occlusionCullingEnabled = true;
+
+RenderQueue renderQueue;
+
+// Sconces, ceiling fixture, exit sign and screen spill, gathered every frame
+// and binned into clusters; benchmarkLights are extra lights the benchmark adds.
+ClusteredLighting clusteredLighting;
+std::vector<PointLight> sceneLights;
+std::vector<PointLight> benchmarkLights;
+
+// Shadows of the main light (room light, or the projector during the movie).
+// Room, door, seats and seated people go in the cached static layer; people
+// on the move are drawn into the dynamic layer every frame.
+ShadowMapCache shadowMaps;
+ShaderProgram shadowShader;
+ShaderProgram shadowInstancedShader;
+unsigned int shadowSeatVAO = 0;
+InstanceBuffer shadowSeatInstances;
+std::vector<const PersonSnapshot*> shadowMovers;
+
+// Irradiance of the static batch for the two main light positions (the room
+// light, dimmed or not, and the projector), baked at startup; the room is
+// then shaded by scaling them with the current light colours.
+enum BakedLight { BAKED_ROOM_LIGHT, BAKED_PROJECTOR_LIGHT };
+LightBaker lightBaker;
+bool bakedLightingEnabled = true;
+
+GeometryBatch staticBatch;
+GeometryBatch dynamicBatch;
+// The dynamic batch is streamed through frameRing; this VAO reads the ring and
+// dynamicBatchFirst is this frame's first vertex in it, or -1 if it did not fit.
+unsigned int dynamicBatchVAO = 0;
+int dynamicBatchFirst = -1;
+BatchRange staticCulledRange = { 0, 0 };
+BatchRange staticUnculledRange = { 0, 0 };
+BatchRange dynamicLitRange = { 0, 0 };
+BatchRange dynamicUnlitRange = { 0, 0 };
+float dynamicBatchDoorAmount = -1.0f;
+bool dynamicBatchLightOn = false;
+
+TextureResidency textureResidency(TEXTURE_VRAM_BUDGET);
+
 unsigned int studentTexture = 0;
 unsigned int crosshairTexture = 0;
 std::vector<unsigned int> frameTextures;
+std::vector<glm::vec3> frameAverageColors;     // per frame texture, taken when it is decoded
 
 void initModels();
-Model3D loadOBJModel(const std::string& objPath);
+bool uploadModel(Model3D& model);
+void unloadModel(Model3D& model);
+Model3D loadOBJModel(const std::string& objPath, float maxTexelsPerMeter);
 void parseMTL(const std::string& mtlPath, const std::string& baseDir,
               std::map<std::string, glm::vec3>& colors,
-              std::map<std::string, GLuint>& textures);
+              std::map<std::string, std::string>& texturePaths);
+int computeTextureMaxDimension(const std::vector<float>& verts, float normalizeScale,
+                               int texWidth, int texHeight, float maxTexelsPerMeter);
 void initSeats();
 void initGeometry();
+void initFrameRing();
+void initSeatInstances();
+void initCrowdInstances();
+void initStaticBatch();
+void updateDynamicBatch();
+void streamDynamicBatch();
+bool streamInstances(const std::vector<InstanceData>& instances, GLuint& baseInstance);
+void buildSeatInstances(const Seat& seat, SeatStatus status, InstanceData* out);
+AABB seatBounds(const Seat& seat);
+glm::mat4 seatBackTransform(const Seat& seat);
+void initOccluders();
+void initBakedLighting();
+void collectSceneLights(std::vector<PointLight>& lights);
+void mainLight(glm::vec3& position, glm::vec3& color, glm::mat4& lightSpace);
+void initShadows();
+void renderShadows();
+void drawPersonShadow(const PersonSnapshot& person);
+glm::mat4 personTransform(const PersonSnapshot& person);
 bool initShaders();
+bool createBasicShaders();
 void initTextures();
+std::string basicShaderDefines(int features);
+const ShaderProgram& getBasicVariant(int features);
+DrawItem basicDrawItem(int features);
+
+void renderFrame(GLFWwindow* window);
+void runBenchmark(GLFWwindow* window);
+void setupBenchmarkHouse();
+double benchmarkGpuMs(GLFWwindow* window, const char* label);
 
 void processInput(GLFWwindow* window, float deltaTime);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void windowRefreshCallback(GLFWwindow* window);
+
+uint64_t sceneSignature();
+bool sceneAnimating();
+bool simulationIdle();
+void resetIdleStats(double now);
+void reportIdleStats(double now);
+void applyFrameCap();
+void limitFrameRate(double frameStart);
+void resetFrameTimeStats(double now);
+void reportFrameTimes(double now);
+void storePreviousSimState();
+glm::vec3 personRenderPosition(const PersonSnapshot& person);
+float personRenderFacing(const PersonSnapshot& person);
+float doorRenderAmount();
+
+void simulationLoop();
+void publishSimSnapshot(double stepTime);
+void consumeSimSnapshot();
+void postSimCommand(SimCommandType type, int value);
+void applySimCommand(const SimCommand& command);
+void toggleSeat(int index);
+void buySeats(int count);
+void startShow();
 
 void updatePeople(float deltaTime);
 void updateMovie(float deltaTime);
 void createPeopleWaypoints();
 void createExitWaypoints();
 
-void renderScene();
+void prepareScene(int width, int height);
+void drawScene();
+void renderOverlays();
 void renderRoom();
 void renderSeats();
 void renderScreen();
+glm::vec3 movieScreenColor();
 void renderPeople();
-void renderHumanoid(const Person& person);
+void prepareSeats();
+void preparePeople();
+void prepareHumanoid(const PersonSnapshot& person, PreparedPerson& out);
 void renderStudentOverlay();
 void renderCrosshair();
 void renderDecorations();
-void renderDoor();
 
-void drawCube(const glm::vec3& pos, const glm::vec3& scale, const glm::vec3& color);
-void drawRotatedCube(const glm::vec3& pos, const glm::vec3& scale, const glm::vec3& color, float angleY);
+glm::mat4 cubeTransform(const glm::vec3& pos, const glm::vec3& scaleVec);
+void bakeCube(GeometryBatch& batch, const glm::vec3& pos, const glm::vec3& scaleVec, const glm::vec3& color);
+int sceneDrawFlags();
 
 bool rayBoxIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDir,
                         const glm::vec3& boxMin, const glm::vec3& boxMax, float& t);
@@ -261,9 +594,21 @@ glm::vec3 getAislePosition(int row) {
     return glm::vec3(aisleX, y, z);
 }
 
-int main() {
+int main(int argc, char** argv) {
     srand((unsigned int)time(NULL));
 
+    bool benchmarkMode = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--benchmark") benchmarkMode = true;
+        for (int cap = 0; cap < FRAME_CAP_COUNT; cap++) {
+            if (arg == std::string("--cap=") + FRAME_CAP_NAMES[cap]) frameCap = (FrameCap)cap;
+        }
+        if (arg.rfind("--resolution-target=", 0) == 0) resolutionSettings.targetMs = (float)atof(arg.c_str() + 20);
+        if (arg.rfind("--resolution-min=", 0) == 0) resolutionSettings.minScale = (float)atof(arg.c_str() + 17);
+        if (arg.rfind("--resolution-max=", 0) == 0) resolutionSettings.maxScale = (float)atof(arg.c_str() + 17);
+    }
+
     if (!glfwInit()) {
         return endProgram("GLFW initialization failed.");
     }
@@ -287,16 +632,17 @@ int main() {
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetMouseButtonCallback(window, mouseButtonCallback);
     glfwSetKeyCallback(window, keyCallback);
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 
     if (glewInit() != GLEW_OK) {
         return endProgram("GLEW initialization failed.");
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.setEnabled(GL_CULL_FACE, true);
     glCullFace(GL_BACK);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.setEnabled(GL_BLEND, true);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     lastX = (float)mode->width / 2.0f;
     lastY = (float)mode->height / 2.0f;
@@ -304,10 +650,25 @@ int main() {
     initModels();
     initSeats();
     initGeometry();
+    initFrameRing();
+    initSeatInstances();
+    initCrowdInstances();
+    initStaticBatch();
+    initOccluders();
+    initBakedLighting();
     if (!initShaders()) {
         return endProgram("Shader initialization failed.");
     }
     initTextures();
+    initShadows();
+    clusteredLighting.create();
+    frameJobs.start(0);
+    profilerGpuInit();
+    sceneResolution.create(resolutionSettings);
+    publishSimSnapshot(glfwGetTime());
+    consumeSimSnapshot();
+    // Model and geometry setup bind VAOs and textures directly.
+    glState.invalidate();
 
     float backRowZBound = ROOM_DEPTH / 2.0f - 5.0f + SEAT_SPACING_Z / 2.0f;
     camera.setRoomBounds(
@@ -329,41 +690,79 @@ int main() {
     std::cout << "Enter: Start movie projection" << std::endl;
     std::cout << "F1: Toggle depth testing" << std::endl;
     std::cout << "F2: Toggle back-face culling" << std::endl;
+    std::cout << "F3: Toggle profiler report" << std::endl;
+    std::cout << "F4: Toggle specialized shader variants" << std::endl;
+    std::cout << "F5: Toggle GL state cache validation" << std::endl;
+    std::cout << "F6: Toggle occlusion culling" << std::endl;
+    std::cout << "F7: Toggle per-vertex normal matrices (compare GPU time in the F3 report)" << std::endl;
+    std::cout << "F8: Toggle baked room lighting" << std::endl;
+    std::cout << "F9: Cycle frame cap (sleep-precise / vsync / uncapped, or --cap=...)" << std::endl;
+    std::cout << "F10: Toggle dynamic resolution (--resolution-target/min/max=...)" << std::endl;
     std::cout << "Escape: Exit" << std::endl;
     std::cout << "========================================" << std::endl;
 
-    float lastTime = (float)glfwGetTime();
-    float accumulator = 0.0f;
-
-    while (!glfwWindowShouldClose(window)) {
-        float currentTime = (float)glfwGetTime();
-        float deltaTime = currentTime - lastTime;
-        lastTime = currentTime;
-        accumulator += deltaTime;
-
-        processInput(window, deltaTime);
+    if (benchmarkMode) {
+        runBenchmark(window);
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
 
-        if (accumulator >= FRAME_TIME) {
-            accumulator -= FRAME_TIME;
+    double lastTime = glfwGetTime();
+    bool lastFrameRendered = true;
+    resetIdleStats(lastTime);
+    resetFrameTimeStats(lastTime);
+    applyFrameCap();
+    simRunning = true;
+    simThread = std::thread(simulationLoop);
 
-            updatePeople(FRAME_TIME);
-            if (currentState == MOVIE || currentState == ENTERING) {
-                updateMovie(FRAME_TIME);
+    while (!glfwWindowShouldClose(window)) {
+        double frameStart = glfwGetTime();
+        double deltaTime = frameStart - lastTime;
+        lastTime = frameStart;
+        if (deltaTime > MAX_FRAME_DELTA) deltaTime = MAX_FRAME_DELTA;
+
+        processInput(window, (float)deltaTime);
+
+        // Drawn a step behind the simulation, blending the snapshot's two steps.
+        consumeSimSnapshot();
+        simAlpha = (float)((glfwGetTime() - frameSnapshot->stepTime) / SIM_TIMESTEP);
+        simAlpha = glm::clamp(simAlpha, 0.0f, 1.0f);
+
+        uint64_t signature = sceneSignature();
+        lastFrameRendered = redrawRequested || signature != renderedSignature || sceneAnimating();
+        if (lastFrameRendered) {
+            renderFrame(window);
+            renderedSignature = signature;
+            redrawRequested = false;
+            idleStats.gpuUs += profilerLastFrame(PROF_GPU_FRAME_US);
+            idleStats.renderedFrames++;
+            limitFrameRate(frameStart);
+            frameTimeStats.frameMs.push_back((float)((glfwGetTime() - frameStart) * 1000.0));
+        } else {
+            idleStats.skippedFrames++;
+        }
+        reportIdleStats(glfwGetTime());
+        reportFrameTimes(glfwGetTime());
+
+        // Queued input the simulation has not applied yet may still change things.
+        bool simSettled = frameSnapshot->commandsApplied == simCommandsPosted;
+        if (!lastFrameRendered && simSettled && simulationIdle()) {
+            // Nothing moves until input arrives, so block instead of polling.
+            double waitStart = glfwGetTime();
+            glfwWaitEventsTimeout(IDLE_MAX_WAIT);
+            idleStats.waited += glfwGetTime() - waitStart;
+            lastTime = glfwGetTime();
+        } else {
+            if (!lastFrameRendered) {
+                // Unchanged until the next snapshot lands, whatever the cap.
+                preciseSleepUntil(std::max(frameSnapshot->stepTime + SIM_TIMESTEP, frameStart + 0.001));
             }
-
-            int width, height;
-            glfwGetFramebufferSize(window, &width, &height);
-            glViewport(0, 0, width, height);
-
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            renderScene();
-
-            glfwSwapBuffers(window);
+            glfwPollEvents();
         }
-
-        glfwPollEvents();
     }
 
+    simRunning = false;
+    simThread.join();
+
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteVertexArrays(1, &quadVAO);
@@ -371,32 +770,231 @@ int main() {
     glDeleteVertexArrays(1, &overlayVAO);
     glDeleteBuffers(1, &overlayVBO);
 
-    if (basicShader) glDeleteProgram(basicShader);
-    if (screenShader) glDeleteProgram(screenShader);
-    if (overlayShader) glDeleteProgram(overlayShader);
-
-    if (studentTexture) glDeleteTextures(1, &studentTexture);
-    if (crosshairTexture) glDeleteTextures(1, &crosshairTexture);
+    glDeleteVertexArrays(1, &seatVAO);
+    glDeleteVertexArrays(1, &dynamicBatchVAO);
+    frameRing.destroy();
+    glDeleteVertexArrays(1, &shadowSeatVAO);
+    shadowSeatInstances.destroy();
+    shadowMaps.destroy();
+    occlusionCuller.shutdown();
+    frameJobs.shutdown();
+    staticBatch.destroy();
+    dynamicBatch.destroy();
+    lightBaker.destroy();
+
+    for (auto& program : basicUberShaders) {
+        program.destroy();
+    }
+    for (auto& program : basicVariants) {
+        program.destroy();
+    }
+    screenShader.destroy();
+    overlayShader.destroy();
+    shadowShader.destroy();
+    shadowInstancedShader.destroy();
+    clusteredLighting.destroy();
+
+    textureResidency.release(studentTexture);
+    textureResidency.release(crosshairTexture);
     for (auto tex : frameTextures) {
-        if (tex) glDeleteTextures(1, &tex);
+        textureResidency.release(tex);
     }
 
     for (auto& model : loadedModels) {
-        for (auto& mesh : model.meshes) {
-            glDeleteVertexArrays(1, &mesh.VAO);
-            glDeleteBuffers(1, &mesh.VBO);
-            if (mesh.diffuseTexture) glDeleteTextures(1, &mesh.diffuseTexture);
-        }
+        unloadModel(model);
     }
+    modelMeshes.destroy();
+    renderQueue.destroy();
+
+    profilerGpuShutdown();
+    sceneResolution.destroy();
 
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
 }
 
+void renderFrame(GLFWwindow* window) {
+    textureResidency.beginFrame();
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    profilerGpuBeginFrame();
+    long long gpuSample;
+    double gpuMs = profilerGpuLastFrameMs(gpuSample);
+    if (gpuSample != resolutionGpuSample) {
+        resolutionGpuSample = gpuSample;
+        sceneResolution.update(gpuMs, glfwGetTime());
+    }
+
+    frameRing.beginFrame();
+    int sceneWidth, sceneHeight;
+    sceneResolution.prepare(width, height, sceneWidth, sceneHeight);
+    streamDynamicBatch();
+    prepareScene(sceneWidth, sceneHeight);
+    // Everything the frame streams is written by now, so one flush serves
+    // the shadow pass and the scene alike.
+    frameRing.flush();
+    renderShadows();
+    sceneResolution.begin();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawScene();
+    sceneResolution.resolve();
+    renderOverlays();
+    frameRing.endFrame();
+    profilerGpuEndFrame();
+
+    glfwSwapBuffers(window);
+    profilerEndFrame(glfwGetTime());
+}
+
+void setupBenchmarkHouse() {
+    people.clear();
+    for (int i = 0; i < TOTAL_SEATS; i++) {
+        seats[i].status = BOUGHT;
+        seats[i].hasOccupant = true;
+
+        Person p;
+        p.assignedSeatIndex = i;
+        p.humanoidType = loadedModels.empty() ? 0 : i % (int)loadedModels.size();
+        p.state = SEATED;
+        p.active = true;
+        p.position = seats[i].position;
+        p.facingAngle = 3.14159265f;
+        people.push_back(p);
+    }
+    storePreviousSimState();
+
+    currentState = MOVIE;
+    movieStartTime = (float)glfwGetTime();
+    roomLightOn = false;
+    publishSimSnapshot(glfwGetTime());
+    consumeSimSnapshot();
+
+    camera.Position = glm::vec3(0.0f, 3.0f, -ROOM_DEPTH / 2.0f + 2.5f);
+    camera.Yaw = 90.0f;
+    camera.Pitch = -5.0f;
+    camera.processMouseMovement(0.0f, 0.0f);
+}
+
+double benchmarkGpuMs(GLFWwindow* window, const char* label) {
+    const int WARMUP_FRAMES = 30;
+    const int MEASURED_FRAMES = 300;
+
+    int resolved = 0;
+    for (int i = 0; i < WARMUP_FRAMES; i++) {
+        renderFrame(window);
+        glfwPollEvents();
+    }
+    glFinish();
+    profilerGpuDrain(resolved);
+
+    for (int i = 0; i < MEASURED_FRAMES; i++) {
+        renderFrame(window);
+        glfwPollEvents();
+    }
+    glFinish();
+    double totalMs = profilerGpuDrain(resolved);
+    double avgMs = resolved > 0 ? totalMs / resolved : 0.0;
+
+    std::cout << "  " << label << ": " << avgMs << " ms GPU per frame (" << resolved << " frames), "
+              << profilerLastFrame(PROF_DRAW_CALLS) << " draws, "
+              << profilerLastFrame(PROF_STATE_CHANGES) << " state changes, "
+              << profilerLastFrame(PROF_GL_CALLS_ELIDED) << " elided, "
+              << profilerLastFrame(PROF_GL_UNIFORM_CALLS) << " uniform gl calls, "
+              << profilerLastFrame(PROF_UNIFORM_LOOKUPS) << " uniform lookups" << std::endl;
+    return avgMs;
+}
+
+void runBenchmark(GLFWwindow* window) {
+    setupBenchmarkHouse();
+    std::cout << "=== BENCHMARK: full house, " << people.size() << " viewers ===" << std::endl;
+    // Every configuration is measured at native resolution.
+    bool savedResolution = sceneResolution.isEnabled();
+    sceneResolution.setEnabled(false);
+
+    bool savedVariants = shaderVariantsEnabled;
+    shaderVariantsEnabled = false;
+    double uberMs = benchmarkGpuMs(window, "uber shader (uniform branches)");
+    shaderVariantsEnabled = true;
+    double variantMs = benchmarkGpuMs(window, "specialized shader variants");
+    shaderVariantsEnabled = savedVariants;
+    if (uberMs > 0.0) {
+        std::cout << "  shader variants saved " << (uberMs - variantMs) << " ms ("
+                  << 100.0 * (uberMs - variantMs) / uberMs << "%)" << std::endl;
+    }
+
+    ShaderProgram::setLookupByName(true);
+    benchmarkGpuMs(window, "uniforms looked up by name");
+    ShaderProgram::setLookupByName(false);
+    benchmarkGpuMs(window, "reflected uniform locations");
+
+    // Same frame twice; only the vertex stage's normal transform differs.
+    bool savedNormals = perVertexNormalMatrices;
+    perVertexNormalMatrices = true;
+    createBasicShaders();
+    double perVertexMs = benchmarkGpuMs(window, "normal matrix inverted per vertex");
+    perVertexNormalMatrices = false;
+    createBasicShaders();
+    double perObjectMs = benchmarkGpuMs(window, "normal matrix from the CPU");
+    if (perVertexNormalMatrices != savedNormals) {
+        perVertexNormalMatrices = savedNormals;
+        createBasicShaders();
+    }
+    if (perVertexMs > 0.0) {
+        std::cout << "  CPU normal matrices saved " << (perVertexMs - perObjectMs) << " ms ("
+                  << 100.0 * (perVertexMs - perObjectMs) / perVertexMs << "%)" << std::endl;
+    }
+
+    // Clustered lighting should stay close to flat as lights are added, since
+    // each fragment only visits the few lights overlapping its froxel.
+    const int lightCounts[] = { 0, 16, 64, 256, 1024 };
+    srand(1234);
+    for (int count : lightCounts) {
+        benchmarkLights.clear();
+        for (int i = 0; i < count; i++) {
+            glm::vec3 position((rand() / (float)RAND_MAX - 0.5f) * ROOM_WIDTH,
+                               rand() / (float)RAND_MAX * ROOM_HEIGHT,
+                               (rand() / (float)RAND_MAX - 0.5f) * ROOM_DEPTH);
+            glm::vec3 color(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+            benchmarkLights.push_back({ position, 2.5f, color * 0.3f });
+        }
+        std::string label = "+" + std::to_string(count) + " clustered lights";
+        benchmarkGpuMs(window, label.c_str());
+        std::cout << "    " << profilerLastFrame(PROF_CLUSTER_LIGHT_REFS) << " light references in "
+                  << CLUSTER_COUNT << " clusters" << std::endl;
+    }
+    benchmarkLights.clear();
+
+    // Occlusion pays off from behind the audience, where seat backs and the
+    // rows in front hide most viewers.
+    camera.Position = glm::vec3(0.0f, STEP_BASE_Y + (ROWS - 1) * ROW_HEIGHT_STEP + 1.2f,
+                                ROOM_DEPTH / 2.0f - 5.0f + SEAT_SPACING_Z / 2.0f);
+    camera.Yaw = -90.0f;
+    camera.Pitch = -15.0f;
+    camera.processMouseMovement(0.0f, 0.0f);
+
+    bool savedOcclusion = occlusionCullingEnabled;
+    occlusionCullingEnabled = false;
+    double visibleMs = benchmarkGpuMs(window, "back row, occlusion culling off");
+    occlusionCullingEnabled = true;
+    double occludedMs = benchmarkGpuMs(window, "back row, occlusion culling on");
+    std::cout << "  " << profilerLastFrame(PROF_OCCLUSION_CULLED) << " of " << people.size()
+              << " viewers occluded" << std::endl;
+    occlusionCullingEnabled = savedOcclusion;
+    if (visibleMs > 0.0) {
+        std::cout << "  occlusion culling saved " << (visibleMs - occludedMs) << " ms ("
+                  << 100.0 * (visibleMs - occludedMs) / visibleMs << "%)" << std::endl;
+    }
+
+    sceneResolution.setEnabled(savedResolution);
+    std::cout << "=== BENCHMARK DONE ===" << std::endl;
+}
+
 void parseMTL(const std::string& mtlPath, const std::string& baseDir,
               std::map<std::string, glm::vec3>& colors,
-              std::map<std::string, GLuint>& textures) {
+              std::map<std::string, std::string>& texturePaths) {
     std::ifstream file(mtlPath);
     if (!file.is_open()) {
         std::cout << "Warning: Could not open MTL file: " << mtlPath << std::endl;
@@ -413,7 +1011,6 @@ void parseMTL(const std::string& mtlPath, const std::string& baseDir,
         if (prefix == "newmtl") {
             iss >> currentMaterial;
             colors[currentMaterial] = glm::vec3(0.7f);
-            textures[currentMaterial] = 0;
         } else if (prefix == "Kd" && !currentMaterial.empty()) {
             float r, g, b;
             iss >> r >> g >> b;
@@ -421,22 +1018,39 @@ void parseMTL(const std::string& mtlPath, const std::string& baseDir,
         } else if (prefix == "map_Kd" && !currentMaterial.empty()) {
             std::string texFile;
             iss >> texFile;
-            std::string texPath = baseDir + "/" + texFile;
-            GLuint tex = loadImageToTexture(texPath.c_str());
-            if (tex) {
-                glBindTexture(GL_TEXTURE_2D, tex);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                glBindTexture(GL_TEXTURE_2D, 0);
-                textures[currentMaterial] = tex;
-            }
+            texturePaths[currentMaterial] = baseDir + "/" + texFile;
         }
     }
 }
 
-Model3D loadOBJModel(const std::string& objPath) {
+int computeTextureMaxDimension(const std::vector<float>& verts, float normalizeScale,
+                               int texWidth, int texHeight, float maxTexelsPerMeter) {
+    double worldArea = 0.0;
+    double uvArea = 0.0;
+    for (size_t i = 0; i + 24 <= verts.size(); i += 24) {
+        glm::vec3 p0(verts[i], verts[i + 1], verts[i + 2]);
+        glm::vec3 p1(verts[i + 8], verts[i + 9], verts[i + 10]);
+        glm::vec3 p2(verts[i + 16], verts[i + 17], verts[i + 18]);
+        worldArea += 0.5 * glm::length(glm::cross(p1 - p0, p2 - p0));
+
+        float du1 = verts[i + 14] - verts[i + 6], dv1 = verts[i + 15] - verts[i + 7];
+        float du2 = verts[i + 22] - verts[i + 6], dv2 = verts[i + 23] - verts[i + 7];
+        uvArea += 0.5 * fabs(du1 * dv2 - du2 * dv1);
+    }
+    worldArea *= (double)normalizeScale * normalizeScale;
+    if (worldArea < 1e-8 || uvArea < 1e-8) return 0;
+
+    double texelsPerMeter = sqrt(uvArea * texWidth * texHeight / worldArea);
+    double factor = maxTexelsPerMeter / texelsPerMeter;
+    if (factor >= 1.0) return 0;
+
+    int maxDim = (int)ceil(std::max(texWidth, texHeight) * factor);
+    maxDim = std::max((maxDim + 3) & ~3, MIN_IMPORT_TEXTURE_SIZE);
+    // 0 when the source already fits, so the import skips the cache lookup.
+    return maxDim < std::max(texWidth, texHeight) ? maxDim : 0;
+}
+
+Model3D loadOBJModel(const std::string& objPath, float maxTexelsPerMeter) {
     Model3D model;
     model.boundsMin = glm::vec3(1e30f);
     model.boundsMax = glm::vec3(-1e30f);
@@ -446,12 +1060,11 @@ Model3D loadOBJModel(const std::string& objPath) {
     std::vector<glm::vec2> texcoords;
 
     std::map<std::string, glm::vec3> matColors;
-    std::map<std::string, GLuint> matTextures;
+    std::map<std::string, std::string> matTexturePaths;
 
     std::map<std::string, std::vector<float>> matVertices;
     std::string currentMaterial = "__default";
     matColors[currentMaterial] = glm::vec3(0.7f);
-    matTextures[currentMaterial] = 0;
 
     std::string baseDir = ".";
     size_t lastSlash = objPath.find_last_of("/\\");
@@ -477,12 +1090,11 @@ Model3D loadOBJModel(const std::string& objPath) {
             std::string mtlFile;
             iss >> mtlFile;
             std::string mtlPath = baseDir + "/" + mtlFile;
-            parseMTL(mtlPath, baseDir, matColors, matTextures);
+            parseMTL(mtlPath, baseDir, matColors, matTexturePaths);
         } else if (prefix == "usemtl") {
             iss >> currentMaterial;
             if (matColors.find(currentMaterial) == matColors.end()) {
                 matColors[currentMaterial] = glm::vec3(0.7f);
-                matTextures[currentMaterial] = 0;
             }
         } else if (prefix == "v") {
             float x, y, z;
@@ -722,52 +1334,41 @@ Model3D loadOBJModel(const std::string& objPath) {
         }
     }
 
+    float modelHeight = model.boundsMax.y - model.boundsMin.y;
+    if (modelHeight > 0.001f) {
+        model.normalizeScale = 1.7f / modelHeight;
+    } else {
+        model.normalizeScale = 1.0f;
+    }
+
     for (auto& pair : matVertices) {
         const std::string& matName = pair.first;
         std::vector<float>& verts = pair.second;
         if (verts.empty()) continue;
 
         ModelMesh mesh;
-        mesh.vertexCount = (int)verts.size() / 8;
         mesh.diffuseColor = matColors.count(matName) ? matColors[matName] : glm::vec3(0.7f);
-        mesh.diffuseTexture = matTextures.count(matName) ? matTextures[matName] : 0;
-
-        glGenVertexArrays(1, &mesh.VAO);
-        glGenBuffers(1, &mesh.VBO);
-        glBindVertexArray(mesh.VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
-        glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        mesh.textureMaxDimension = 0;
+
+        if (matTexturePaths.count(matName)) {
+            mesh.texturePath = matTexturePaths[matName];
+            int texWidth, texHeight, texChannels;
+            if (readImageSize(mesh.texturePath, texWidth, texHeight, texChannels)) {
+                mesh.textureMaxDimension = computeTextureMaxDimension(verts, model.normalizeScale, texWidth, texHeight,
+                                                                      maxTexelsPerMeter);
+            }
+        }
 
-        model.meshes.push_back(mesh);
+        mesh.vertices.swap(verts);
+        model.meshes.push_back(std::move(mesh));
     }
 
-    float modelHeight = model.boundsMax.y - model.boundsMin.y;
-    if (modelHeight > 0.001f) {
-        model.normalizeScale = 1.7f / modelHeight;
-    } else {
-        model.normalizeScale = 1.0f;
-    }
     model.centerOffset = glm::vec3(
         -(model.boundsMin.x + model.boundsMax.x) * 0.5f,
         -model.boundsMin.y,
         -(model.boundsMin.z + model.boundsMax.z) * 0.5f
     );
 
-    int totalVerts = 0;
-    for (auto& m : model.meshes) totalVerts += m.vertexCount;
-    std::cout << "  Loaded: " << totalVerts << " vertices, " << model.meshes.size() << " material groups" << std::endl;
-
     return model;
 }
 
@@ -802,15 +1403,23 @@ void initModels() {
 
     int numModels = sizeof(modelPaths) / sizeof(modelPaths[0]);
     std::cout << "Loading " << numModels << " 3D models..." << std::endl;
+    modelMeshes.create(MODEL_BUFFER_VERTICES, MODEL_BUFFER_INDICES);
+
+    int viewportWidth, viewportHeight;
+    glfwGetFramebufferSize(glfwGetCurrentContext(), &viewportWidth, &viewportHeight);
+    float maxTexelsPerMeter = (float)viewportHeight /
+        (2.0f * NEAREST_VIEW_DISTANCE * tanf(glm::radians(camera.Fov) / 2.0f));
+    std::cout << "Texture import cap: " << maxTexelsPerMeter << " texels/m (viewport height "
+              << viewportHeight << ", nearest view " << NEAREST_VIEW_DISTANCE << " m)" << std::endl;
 
     for (int i = 0; i < numModels; i++) {
         std::cout << "Loading model " << (i + 1) << "/" << numModels << ": " << modelPaths[i] << std::endl;
-        Model3D m = loadOBJModel(modelPaths[i]);
+        Model3D m = loadOBJModel(modelPaths[i], maxTexelsPerMeter);
         if (!m.meshes.empty()) {
 
             bool allDefault = true;
             for (auto& mesh : m.meshes) {
-                if (mesh.diffuseTexture != 0 ||
+                if (!mesh.texturePath.empty() ||
                     mesh.diffuseColor.x != 0.7f || mesh.diffuseColor.y != 0.7f || mesh.diffuseColor.z != 0.7f) {
                     allDefault = false;
                     break;
@@ -824,13 +1433,110 @@ void initModels() {
                 }
                 std::cout << "  Assigned fallback color to model without MTL." << std::endl;
             }
-            loadedModels.push_back(m);
+            if (uploadModel(m)) loadedModels.push_back(std::move(m));
         } else {
             std::cout << "  WARNING: Model has no meshes, skipping." << std::endl;
         }
     }
 
-    std::cout << "Successfully loaded " << loadedModels.size() << " models." << std::endl;
+    const RangeAllocator& vertexRanges = modelMeshes.getVertexRanges();
+    const RangeAllocator& indexRanges = modelMeshes.getIndexRanges();
+    std::cout << "Successfully loaded " << loadedModels.size() << " models. Model buffer: "
+              << vertexRanges.getCapacity() - vertexRanges.getFreeTotal() << "/" << vertexRanges.getCapacity()
+              << " vertices, " << indexRanges.getCapacity() - indexRanges.getFreeTotal() << "/"
+              << indexRanges.getCapacity() << " indices" << std::endl;
+}
+
+// Packs the model's textures into arrays (a layer per textured group, one
+// array per texture size) and merges every material group into one index
+// range, with the group's colour and layer carried per vertex. Groups are
+// ordered by array, so a whole model is one draw per array.
+bool uploadModel(Model3D& model) {
+    std::vector<std::string> texturePaths;
+    std::vector<int> maxDimensions;
+    std::vector<int> meshTexture(model.meshes.size(), -1);
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        const ModelMesh& mesh = model.meshes[i];
+        if (mesh.texturePath.empty()) continue;
+        meshTexture[i] = (int)texturePaths.size();
+        texturePaths.push_back(mesh.texturePath);
+        maxDimensions.push_back(mesh.textureMaxDimension);
+    }
+
+    std::vector<GLuint> arrays;
+    TextureArrayInfo info;
+    if (!texturePaths.empty()) {
+        arrays = textureResidency.loadArrays(texturePaths, maxDimensions, GL_REPEAT, &info);
+    }
+
+    // Untextured groups only use their colour, so they join the first array's range.
+    std::vector<int> meshArray(model.meshes.size(), 0);
+    for (size_t i = 0; i < model.meshes.size(); i++) {
+        if (meshTexture[i] >= 0 && info.arrays[meshTexture[i]] >= 0) meshArray[i] = info.arrays[meshTexture[i]];
+    }
+
+    model.materials.clear();
+    std::vector<float> triangles;
+    size_t rangeCount = arrays.empty() ? 1 : arrays.size();
+    for (size_t array = 0; array < rangeCount; array++) {
+        MaterialRange range;
+        range.textures = arrays.empty() ? 0 : arrays[array];
+        range.firstIndex = (uint32_t)(triangles.size() / MESH_VERTEX_FLOATS);
+
+        for (size_t i = 0; i < model.meshes.size(); i++) {
+            if (meshArray[i] != (int)array) continue;
+            ModelMesh& mesh = model.meshes[i];
+            float layer = -1.0f;
+            if (meshTexture[i] >= 0 && info.arrays[meshTexture[i]] >= 0) layer = (float)info.layers[meshTexture[i]];
+
+            for (size_t v = 0; v + 8 <= mesh.vertices.size(); v += 8) {
+                triangles.insert(triangles.end(), mesh.vertices.begin() + v, mesh.vertices.begin() + v + 8);
+                triangles.push_back(mesh.diffuseColor.x);
+                triangles.push_back(mesh.diffuseColor.y);
+                triangles.push_back(mesh.diffuseColor.z);
+                triangles.push_back(layer);
+            }
+            std::vector<float>().swap(mesh.vertices);
+        }
+
+        // Every triangle corner becomes one index, so ranges follow the triangle order.
+        range.indexCount = (uint32_t)(triangles.size() / MESH_VERTEX_FLOATS) - range.firstIndex;
+        if (range.indexCount > 0) model.materials.push_back(range);
+    }
+
+    std::vector<float> uniqueVerts;
+    std::vector<uint32_t> indices;
+    indexMeshVertices(triangles, uniqueVerts, indices);
+    if (!modelMeshes.add(uniqueVerts.data(), (uint32_t)(uniqueVerts.size() / MESH_VERTEX_FLOATS),
+                         indices.data(), (uint32_t)indices.size(), model.geometry)) {
+        std::cout << "  WARNING: No room for the model in the model buffer" << std::endl;
+        for (GLuint texture : arrays) textureResidency.release(texture);
+        model.materials.clear();
+        return false;
+    }
+
+    std::cout << "  Loaded: " << model.geometry.vertexCount << " unique vertices, " << model.geometry.indexCount
+              << " indices, " << model.meshes.size() << " material groups in " << model.materials.size()
+              << (model.materials.size() == 1 ? " draw" : " draws") << std::endl;
+    for (size_t array = 0; array < arrays.size(); array++) {
+        int layers = (int)std::count(info.arrays.begin(), info.arrays.end(), (int)array);
+        std::cout << "  Textures: " << layers << " layers at " << info.widths[array] << "x" << info.heights[array]
+                  << std::endl;
+    }
+    if (!arrays.empty()) {
+        std::cout << "  Texture memory: " << info.sourceBytes / 1024 << " KB source -> "
+                  << info.importedBytes / 1024 << " KB in arrays" << std::endl;
+    }
+    return true;
+}
+
+// Returns a model's ranges to the shared buffer; freed neighbours merge, so
+// the space can be reused by models of any size.
+void unloadModel(Model3D& model) {
+    modelMeshes.remove(model.geometry);
+    for (const MaterialRange& range : model.materials) textureResidency.release(range.textures);
+    model.materials.clear();
+    model.meshes.clear();
 }
 
 void initSeats() {
@@ -890,21 +1596,233 @@ void initGeometry() {
     glBindVertexArray(0);
 }
 
+void initSeatInstances() {
+    seatInstanceData.resize(seats.size() * SEAT_PARTS);
+    for (size_t i = 0; i < seats.size(); i++) {
+        buildSeatInstances(seats[i], seats[i].status, &seatInstanceData[i * SEAT_PARTS]);
+        builtSeatStatus.push_back(seats[i].status);
+    }
+    packedSeats.clear();
+
+    glGenVertexArrays(1, &seatVAO);
+    glBindVertexArray(seatVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    attachInstanceAttributes(seatVAO, frameRing.id());
+}
+
+glm::mat4 cubeTransform(const glm::vec3& pos, const glm::vec3& scaleVec) {
+    glm::mat4 model(1.0f);
+    model = glm::translate(model, pos);
+    return glm::scale(model, scaleVec);
+}
+
+void buildSeatInstances(const Seat& seat, SeatStatus status, InstanceData* out) {
+    glm::vec3 fabricColor;
+    switch (status) {
+        case FREE:     fabricColor = glm::vec3(0.15f, 0.25f, 0.5f); break;
+        case RESERVED: fabricColor = glm::vec3(0.7f, 0.6f, 0.1f); break;
+        case BOUGHT:   fabricColor = glm::vec3(0.6f, 0.15f, 0.15f); break;
+    }
+    glm::vec3 frameColor(0.2f, 0.15f, 0.1f);
+    glm::vec3 armrestColor(0.15f, 0.1f, 0.08f);
+
+    out[0] = makeInstanceData(cubeTransform(seat.position + glm::vec3(0.0f, 0.05f, 0.0f),
+        glm::vec3(SEAT_SIZE + 0.1f, 0.1f, SEAT_SIZE + 0.1f)), frameColor);
+    out[1] = makeInstanceData(cubeTransform(seat.position + glm::vec3(0.0f, SEAT_SIZE / 4.0f + 0.05f, -0.05f),
+        glm::vec3(SEAT_SIZE - 0.05f, SEAT_SIZE / 2.5f, SEAT_SIZE - 0.1f)), fabricColor);
+    out[2] = makeInstanceData(seatBackTransform(seat), fabricColor * 0.9f);
+    out[3] = makeInstanceData(cubeTransform(seat.position + glm::vec3(-SEAT_SIZE / 2.0f - 0.08f, SEAT_SIZE * 0.4f, 0.0f),
+        glm::vec3(0.1f, 0.08f, SEAT_SIZE * 0.7f)), armrestColor);
+    out[4] = makeInstanceData(cubeTransform(seat.position + glm::vec3(SEAT_SIZE / 2.0f + 0.08f, SEAT_SIZE * 0.4f, 0.0f),
+        glm::vec3(0.1f, 0.08f, SEAT_SIZE * 0.7f)), armrestColor);
+}
+
+void initCrowdInstances() {
+    crowdInstanceData.resize(loadedModels.size());
+    crowdNearestDepth.resize(loadedModels.size());
+    attachInstanceAttributes(modelMeshes.getVAO(), frameRing.id());
+}
+
+void initFrameRing() {
+    frameRing.create(FRAME_RING_BYTES);
+    std::cout << "Frame ring buffer: " << (frameRing.isPersistent() ? "persistent mapped" : "orphaned uploads")
+              << ", " << RING_FRAMES << " x " << FRAME_RING_BYTES / 1024 << " KB" << std::endl;
+    glGenVertexArrays(1, &dynamicBatchVAO);
+    attachBatchVertices(dynamicBatchVAO, frameRing.id());
+}
+
+// Copies instances into this frame's ring space. VAOs read instances from the
+// start of the ring, so the allocation's offset becomes a base instance.
+bool streamInstances(const std::vector<InstanceData>& instances, GLuint& baseInstance) {
+    size_t bytes = instances.size() * sizeof(InstanceData);
+    RingAllocation allocation = frameRing.allocate(bytes, sizeof(InstanceData));
+    if (!allocation.data) return false;
+    memcpy(allocation.data, instances.data(), bytes);
+    baseInstance = (GLuint)(allocation.offset / sizeof(InstanceData));
+    return true;
+}
+
+glm::mat4 seatBackTransform(const Seat& seat) {
+    return cubeTransform(seat.position + glm::vec3(0.0f, SEAT_SIZE * 0.7f, SEAT_SIZE / 2.0f - 0.08f),
+        glm::vec3(SEAT_SIZE - 0.05f, SEAT_SIZE * 0.9f, 0.12f));
+}
+
+// Stairs, side fills and seat backs hide most of the audience from the front
+// of the room; they never move, so the triangle list is built once.
+void initOccluders() {
+    std::vector<glm::vec3> triangles;
+    const std::vector<BatchVertex>& batchVertices = staticBatch.getVertices();
+    for (int i = 0; i < staticUnculledRange.count; i++) {
+        const float* p = batchVertices[staticUnculledRange.first + i].position;
+        triangles.push_back(glm::vec3(p[0], p[1], p[2]));
+    }
+    for (const Seat& seat : seats) {
+        glm::mat4 model = seatBackTransform(seat);
+        for (int i = 0; i < 36; i++) {
+            const float* p = &cubeVertices[i * 8];
+            triangles.push_back(glm::vec3(model * glm::vec4(p[0], p[1], p[2], 1.0f)));
+        }
+    }
+    occlusionCuller.setOccluders(triangles);
+    occlusionCuller.start();
+    std::cout << "Occlusion culling: " << occlusionCuller.getOccluderTriangles() << " occluder triangles" << std::endl;
+}
+
+// Runs after initOccluders so the occlusion culler keeps the coarse triangles.
+// Seats block and bounce light in the bake but are not baked themselves.
+void initBakedLighting() {
+    std::vector<BatchRange*> ranges = { &staticCulledRange, &staticUnculledRange };
+    staticBatch.subdivide(BAKE_MAX_EDGE, ranges);
+    staticBatch.upload(GL_STATIC_DRAW);
+
+    GeometryBatch seatOccluders;
+    for (const InstanceData& part : seatInstanceData) {
+        glm::mat4 model(1.0f);
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) model[c][r] = part.modelRows[r][c];
+        }
+        seatOccluders.addMesh(cubeVertices, 36, model, glm::vec3(part.color));
+    }
+
+    glm::vec3 lights[BAKED_LIGHT_COUNT];
+    lights[BAKED_ROOM_LIGHT] = mainLightPos;
+    lights[BAKED_PROJECTOR_LIGHT] = PROJECTOR_LIGHT_POS;
+    lightBaker.bake(staticBatch.getVertices(), seatOccluders.getVertices(), lights, BAKE_SETTINGS);
+    lightBaker.attach(staticBatch.getVAO());
+    glBindVertexArray(0);
+}
+
+AABB seatBounds(const Seat& seat) {
+    // Encloses the frame, cushion, backrest and both armrests.
+    glm::vec3 halfExtent(SEAT_SIZE / 2.0f + 0.13f, 0.0f, SEAT_SIZE / 2.0f + 0.05f);
+    AABB box;
+    box.min = seat.position - halfExtent;
+    box.max = seat.position + halfExtent;
+    box.max.y += SEAT_SIZE * 1.15f;
+    return box;
+}
+
 bool initShaders() {
-    basicShader = createShader("Shaders/basic.vert", "Shaders/basic.frag");
-    screenShader = createShader("Shaders/screen.vert", "Shaders/screen.frag");
-    overlayShader = createShader("Shaders/overlay.vert", "Shaders/overlay.frag");
-    return basicShader && screenShader && overlayShader;
+    bool ok = createBasicShaders();
+    ok = screenShader.create("Shaders/screen.vert", "Shaders/screen.frag") && ok;
+    ok = overlayShader.create("Shaders/overlay.vert", "Shaders/overlay.frag") && ok;
+    ok = shadowShader.create("Shaders/shadow.vert", "Shaders/shadow.frag") && ok;
+    ok = shadowInstancedShader.create("Shaders/shadow.vert", "Shaders/shadow.frag", "#define USE_INSTANCING\n") && ok;
+    if (!ok) return false;
+
+    screenShader.use();
+    screenShader.setInt(UNIFORM_TEXTURE, 0);
+    overlayShader.use();
+    overlayShader.setInt(UNIFORM_TEXTURE, 0);
+    glState.useProgram(0);
+    return true;
+}
+
+// (Re)builds the uber shaders and every variant; also used when toggling
+// perVertexNormalMatrices.
+bool createBasicShaders() {
+    for (auto& program : basicVariants) program.destroy();
+
+    bool ok = true;
+    for (int i = 0; i < BASIC_UBER_COUNT; i++) {
+        std::string defines = "#define UBER_SHADER\n" + basicShaderDefines(i << BASIC_GEOMETRY_SHIFT);
+        ok = basicUberShaders[i].create("Shaders/basic.vert", "Shaders/basic.frag", defines) && ok;
+    }
+    for (int features = 0; features < BASIC_VARIANT_COUNT; features++) {
+        if (!getBasicVariant(features).id()) ok = false;
+    }
+    if (!ok) return false;
+
+    // Samplers and the basic alpha never change, so they are set once here.
+    for (auto& program : basicUberShaders) {
+        program.use();
+        program.setInt(UNIFORM_TEXTURE, 0);
+        program.setInt(UNIFORM_MATERIAL_TEXTURES, MATERIAL_TEXTURE_UNIT);
+        program.setInt(UNIFORM_CLUSTER_OFFSETS, CLUSTER_OFFSETS_UNIT);
+        program.setInt(UNIFORM_CLUSTER_INDICES, CLUSTER_INDICES_UNIT);
+        program.setInt(UNIFORM_CLUSTER_LIGHTS, CLUSTER_LIGHTS_UNIT);
+        program.setInt(UNIFORM_SHADOW_MAP, SHADOW_MAP_UNIT);
+        program.setFloat(UNIFORM_ALPHA, 1.0f);
+    }
+    for (auto& program : basicVariants) {
+        program.use();
+        program.setInt(UNIFORM_TEXTURE, 0);
+        program.setInt(UNIFORM_MATERIAL_TEXTURES, MATERIAL_TEXTURE_UNIT);
+        program.setInt(UNIFORM_CLUSTER_OFFSETS, CLUSTER_OFFSETS_UNIT);
+        program.setInt(UNIFORM_CLUSTER_INDICES, CLUSTER_INDICES_UNIT);
+        program.setInt(UNIFORM_CLUSTER_LIGHTS, CLUSTER_LIGHTS_UNIT);
+        program.setInt(UNIFORM_SHADOW_MAP, SHADOW_MAP_UNIT);
+        program.setFloat(UNIFORM_ALPHA, 1.0f);
+    }
+    // Deleted program names can be reused, so the cached binding is stale.
+    glState.invalidate();
+    glState.useProgram(0);
+    return true;
+}
+
+std::string basicShaderDefines(int features) {
+    std::string defines;
+    if (features & BASIC_FEATURE_LIGHTING) defines += "#define USE_LIGHTING\n";
+    if (features & BASIC_FEATURE_TEXTURE) defines += "#define USE_TEXTURE\n";
+    if (features & BASIC_FEATURE_INSTANCED) defines += "#define USE_INSTANCING\n";
+    if (features & BASIC_FEATURE_VERTEX_COLOR) defines += "#define USE_VERTEX_COLOR\n";
+    if (features & BASIC_FEATURE_MATERIAL_ARRAY) defines += "#define USE_MATERIAL_ARRAY\n";
+    if (features & BASIC_FEATURE_BAKED_LIGHTING) defines += "#define USE_BAKED_LIGHTING\n";
+    if (perVertexNormalMatrices) defines += "#define NORMAL_MATRIX_PER_VERTEX\n";
+    return defines;
+}
+
+const ShaderProgram& getBasicVariant(int features) {
+    if (!basicVariants[features].id()) {
+        basicVariants[features].create("Shaders/basic.vert", "Shaders/basic.frag", basicShaderDefines(features));
+    }
+    return basicVariants[features];
+}
+
+DrawItem basicDrawItem(int features) {
+    DrawItem item;
+    if (shaderVariantsEnabled) {
+        item.program = &getBasicVariant(features);
+    } else {
+        item.program = &basicUberShaders[features >> BASIC_GEOMETRY_SHIFT];
+        item.setInt(UNIFORM_USE_LIGHTING, (features & BASIC_FEATURE_LIGHTING) ? 1 : 0);
+        item.setInt(UNIFORM_USE_TEXTURE, (features & BASIC_FEATURE_TEXTURE) ? 1 : 0);
+    }
+    return item;
 }
 
 void initTextures() {
 
-    crosshairTexture = loadImageToTexture("Resources/camera.png");
+    crosshairTexture = textureResidency.loadOverlay("Resources/camera.png");
     if (crosshairTexture) {
-        glBindTexture(GL_TEXTURE_2D, crosshairTexture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, 0);
         std::cout << "Loaded camera.png as crosshair icon." << std::endl;
     } else {
 
@@ -917,28 +1835,24 @@ void initTextures() {
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
-    studentTexture = loadImageToTexture("Resources/student.png");
-    if (studentTexture) {
-        glBindTexture(GL_TEXTURE_2D, studentTexture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, 0);
-    }
+    studentTexture = textureResidency.loadOverlay("Resources/student.png");
 
     for (int i = 1; i <= MAX_FRAME_TEXTURES; i++) {
         char path[256];
         sprintf_s(path, sizeof(path), "Resources/frames/frame%02d.png", i);
-        unsigned int tex = loadImageToTexture(path);
+        TextureLoadInfo info;
+        unsigned int tex = textureResidency.load(path, GL_CLAMP_TO_EDGE, 0, &info);
         if (tex) {
-            glBindTexture(GL_TEXTURE_2D, tex);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glBindTexture(GL_TEXTURE_2D, 0);
             frameTextures.push_back(tex);
+            frameAverageColors.push_back(glm::vec3(info.averageColor[0], info.averageColor[1], info.averageColor[2]));
         }
     }
 
     std::cout << "Loaded " << frameTextures.size() << " movie frames." << std::endl;
+
+    const TextureResidencyStats& texStats = textureResidency.getStats();
+    std::cout << "Texture residency: " << texStats.residentBytes / (1024 * 1024) << " MB resident, budget "
+              << texStats.budgetBytes / (1024 * 1024) << " MB." << std::endl;
 }
 
 void createPeopleWaypoints() {
@@ -959,6 +1873,7 @@ void createPeopleWaypoints() {
 
         glm::vec3 startPos = DOOR_POSITION + glm::vec3(0.0f, 0.1f, 0.5f);
         p.position = startPos;
+        p.previousPosition = startPos;
         p.waypoints.push_back(startPos);
 
         float aisleX = getAislePosition(ROWS - 1).x;
@@ -1091,19 +2006,11 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
 }
 
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
-    if (currentState != WAITING) return;
+    if (frameSnapshot->state != WAITING) return;
     if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) return;
 
     int seatIndex = findSeatUnderCrosshair();
-    if (seatIndex >= 0) {
-        if (seats[seatIndex].status == FREE) {
-            seats[seatIndex].status = RESERVED;
-            std::cout << "Seat [" << seats[seatIndex].row << "," << seats[seatIndex].col << "] reserved." << std::endl;
-        } else if (seats[seatIndex].status == RESERVED) {
-            seats[seatIndex].status = FREE;
-            std::cout << "Seat [" << seats[seatIndex].row << "," << seats[seatIndex].col << "] unreserved." << std::endl;
-        }
-    }
+    if (seatIndex >= 0) postSimCommand(SIM_TOGGLE_SEAT, seatIndex);
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -1113,67 +2020,351 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     }
 
     if (action != GLFW_PRESS) return;
+    // Toggles change the picture without changing the tracked scene state.
+    redrawRequested = true;
 
     if (key == GLFW_KEY_F1) {
         depthTestEnabled = !depthTestEnabled;
-        if (depthTestEnabled) glEnable(GL_DEPTH_TEST);
-        else glDisable(GL_DEPTH_TEST);
         std::cout << "Depth testing: " << (depthTestEnabled ? "ON" : "OFF") << std::endl;
     }
 
     if (key == GLFW_KEY_F2) {
         cullingEnabled = !cullingEnabled;
-        if (cullingEnabled) glEnable(GL_CULL_FACE);
-        else glDisable(GL_CULL_FACE);
         std::cout << "Back-face culling: " << (cullingEnabled ? "ON" : "OFF") << std::endl;
     }
 
-    if (currentState == WAITING && key >= GLFW_KEY_1 && key <= GLFW_KEY_9) {
-        int n = key - GLFW_KEY_0;
-        std::vector<int> indices;
-        if (findNAdjacentSeats(n, indices)) {
-            for (int idx : indices) seats[idx].status = BOUGHT;
-            std::cout << "Bought " << n << " ticket(s)." << std::endl;
-        } else {
-            std::cout << "Cannot find " << n << " adjacent free seats!" << std::endl;
-        }
+    if (key == GLFW_KEY_F4) {
+        shaderVariantsEnabled = !shaderVariantsEnabled;
+        std::cout << "Shader variants: " << (shaderVariantsEnabled ? "ON" : "OFF (uber shader)") << std::endl;
     }
 
-    if (key == GLFW_KEY_ENTER && currentState == WAITING) {
+    if (key == GLFW_KEY_F3) {
+        profilerSetReporting(!profilerIsReporting());
+        std::cout << "Profiler report: " << (profilerIsReporting() ? "ON" : "OFF") << std::endl;
+    }
 
-        std::vector<int> occupiedSeats;
-        for (int i = 0; i < TOTAL_SEATS; i++) {
-            if (seats[i].status == RESERVED || seats[i].status == BOUGHT)
-                occupiedSeats.push_back(i);
-        }
+    if (key == GLFW_KEY_F5) {
+        glState.setValidation(!glState.isValidating());
+        std::cout << "GL state validation: " << (glState.isValidating() ? "ON" : "OFF") << std::endl;
+    }
 
-        if (occupiedSeats.empty()) {
-            std::cout << "No reserved seats!" << std::endl;
-            return;
-        }
+    if (key == GLFW_KEY_F6) {
+        occlusionCullingEnabled = !occlusionCullingEnabled;
+        std::cout << "Occlusion culling: " << (occlusionCullingEnabled ? "ON" : "OFF") << std::endl;
+    }
+
+    if (key == GLFW_KEY_F7) {
+        perVertexNormalMatrices = !perVertexNormalMatrices;
+        createBasicShaders();
+        std::cout << "Normal matrices: " << (perVertexNormalMatrices ? "per vertex (GPU inverse)" : "per object (CPU)")
+                  << std::endl;
+    }
+
+    if (key == GLFW_KEY_F8) {
+        bakedLightingEnabled = !bakedLightingEnabled;
+        std::cout << "Room lighting: " << (bakedLightingEnabled ? "baked" : "dynamic") << std::endl;
+    }
+
+    if (key == GLFW_KEY_F9) {
+        frameCap = (FrameCap)((frameCap + 1) % FRAME_CAP_COUNT);
+        applyFrameCap();
+        resetFrameTimeStats(glfwGetTime());
+        std::cout << "Frame cap: " << FRAME_CAP_NAMES[frameCap] << std::endl;
+    }
+
+    if (key == GLFW_KEY_F10) {
+        sceneResolution.setEnabled(!sceneResolution.isEnabled());
+        std::cout << "Dynamic resolution: " << (sceneResolution.isEnabled() ? "ON" : "OFF (native)") << std::endl;
+    }
+
+    if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9) postSimCommand(SIM_BUY_SEATS, key - GLFW_KEY_0);
+    if (key == GLFW_KEY_ENTER) postSimCommand(SIM_START_SHOW, 0);
+}
+
+void windowRefreshCallback(GLFWwindow*) {
+    redrawRequested = true;
+}
+
+template <typename T>
+static void hashValue(uint64_t& hash, const T& value) {
+    const unsigned char* bytes = (const unsigned char*)&value;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+uint64_t sceneSignature() {
+    uint64_t hash = 1469598103934665603ull;
+    hashValue(hash, camera.Position);
+    hashValue(hash, camera.Yaw);
+    hashValue(hash, camera.Pitch);
+    hashValue(hash, camera.Fov);
+    const SimSnapshot& sim = *frameSnapshot;
+    hashValue(hash, sim.seatStatus);
+    for (const PersonSnapshot& p : sim.people) {
+        hashValue(hash, p.active);
+        hashValue(hash, p.state);
+        hashValue(hash, personRenderPosition(p));
+        hashValue(hash, personRenderFacing(p));
+        hashValue(hash, p.walkCycle);
+    }
+    hashValue(hash, doorRenderAmount());
+    hashValue(hash, sim.state);
+    hashValue(hash, sim.frameIndex);
+    hashValue(hash, sim.roomLightOn);
+    return hash;
+}
+
+// Changes the picture every tick without touching the tracked state: the
+// colour cycle shown when no movie frames were loaded.
+bool sceneAnimating() {
+    return frameSnapshot->state == MOVIE && frameTextures.empty();
+}
+
+// Nothing advances with time: no show running and the door at rest.
+bool simulationIdle() {
+    const SimSnapshot& sim = *frameSnapshot;
+    return sim.state == WAITING && sim.doorOpenAmount == 0.0f && sim.previousDoorOpenAmount == 0.0f;
+}
+
+void resetIdleStats(double now) {
+    idleStats.start = now;
+    idleStats.cpuStart = processCpuSeconds();
+    idleStats.waited = 0.0;
+    idleStats.gpuUs = 0;
+    idleStats.renderedFrames = 0;
+    idleStats.skippedFrames = 0;
+}
 
-        int numPeople = 1 + rand() % (int)occupiedSeats.size();
+// CPU is the process's share of one core, GPU the measured frame time over
+// wall time; printed only for intervals in which the loop slept.
+void reportIdleStats(double now) {
+    double elapsed = now - idleStats.start;
+    if (elapsed < IDLE_REPORT_INTERVAL) return;
+    if (idleStats.waited > 0.0) {
+        double cpu = processCpuSeconds() - idleStats.cpuStart;
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "Idle: %d frames rendered, %d skipped, asleep %.0f%%, CPU %.1f%%, GPU %.2f%% over %.1f s",
+                 idleStats.renderedFrames, idleStats.skippedFrames, 100.0 * idleStats.waited / elapsed,
+                 100.0 * cpu / elapsed, 100.0 * (double)idleStats.gpuUs / (elapsed * 1.0e6), elapsed);
+        std::cout << line << std::endl;
+    }
+    resetIdleStats(now);
+}
+
+void applyFrameCap() {
+    glfwSwapInterval(frameCap == FRAME_CAP_VSYNC ? 1 : 0);
+}
+
+void limitFrameRate(double frameStart) {
+    if (frameCap == FRAME_CAP_SLEEP) preciseSleepUntil(frameStart + FRAME_TIME);
+}
+
+void resetFrameTimeStats(double now) {
+    frameTimeStats.start = now;
+    frameTimeStats.frameMs.clear();
+    frameTimeStats.simStepsStart = frameSnapshot->steps;
+    frameTimeStats.droppedStepsStart = frameSnapshot->droppedSteps;
+}
 
-        for (int i = (int)occupiedSeats.size() - 1; i > 0; i--) {
-            int j = rand() % (i + 1);
-            std::swap(occupiedSeats[i], occupiedSeats[j]);
+static float percentile(std::vector<float>& sorted, float fraction) {
+    size_t index = (size_t)(fraction * (float)(sorted.size() - 1) + 0.5f);
+    return sorted[index];
+}
+
+void reportFrameTimes(double now) {
+    double elapsed = now - frameTimeStats.start;
+    if (elapsed < FRAME_REPORT_INTERVAL) return;
+    std::vector<float>& times = frameTimeStats.frameMs;
+    if (!times.empty()) {
+        std::sort(times.begin(), times.end());
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "Frames (%s): %d in %.1f s, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms; "
+                 "%.0f sim steps/s, %d dropped",
+                 FRAME_CAP_NAMES[frameCap], (int)times.size(), elapsed, percentile(times, 0.5f),
+                 percentile(times, 0.95f), percentile(times, 0.99f), times.back(),
+                 (frameSnapshot->steps - frameTimeStats.simStepsStart) / elapsed,
+                 (int)(frameSnapshot->droppedSteps - frameTimeStats.droppedStepsStart));
+        std::cout << line << std::endl;
+        sceneResolution.report(now);
+    }
+    resetFrameTimeStats(now);
+}
+
+void storePreviousSimState() {
+    for (Person& p : people) {
+        p.previousPosition = p.position;
+        p.previousFacingAngle = p.facingAngle;
+    }
+    previousDoorOpenAmount = doorOpenAmount;
+}
+
+glm::vec3 personRenderPosition(const PersonSnapshot& person) {
+    return person.previousPosition + (person.position - person.previousPosition) * simAlpha;
+}
+
+// Blends along the shorter arc; atan2 wraps at +-pi.
+float personRenderFacing(const PersonSnapshot& person) {
+    const float PI = 3.14159265f;
+    float delta = person.facingAngle - person.previousFacingAngle;
+    if (delta > PI) delta -= 2.0f * PI;
+    if (delta < -PI) delta += 2.0f * PI;
+    return person.previousFacingAngle + delta * simAlpha;
+}
+
+float doorRenderAmount() {
+    const SimSnapshot& sim = *frameSnapshot;
+    return sim.previousDoorOpenAmount + (sim.doorOpenAmount - sim.previousDoorOpenAmount) * simAlpha;
+}
+
+// Fixed-step simulation on its own thread. Queued commands are applied before
+// the next step and every batch of steps ends in a published snapshot; the
+// GL thread never waits for either.
+void simulationLoop() {
+    double lastTime = glfwGetTime();
+    double accumulator = 0.0;
+
+    while (simRunning.load()) {
+        double now = glfwGetTime();
+        double deltaTime = now - lastTime;
+        lastTime = now;
+        if (deltaTime > MAX_FRAME_DELTA) deltaTime = MAX_FRAME_DELTA;
+        accumulator += deltaTime;
+
+        bool changed = false;
+        SimCommand command;
+        while (simCommands.pop(command)) {
+            applySimCommand(command);
+            simCommandsApplied++;
+            changed = true;
         }
 
-        people.clear();
-        for (int i = 0; i < numPeople; i++) {
-            Person p;
-            p.assignedSeatIndex = occupiedSeats[i];
-            p.humanoidType = loadedModels.empty() ? 0 : rand() % (int)loadedModels.size();
-            people.push_back(p);
-            seats[occupiedSeats[i]].hasOccupant = true;
+        int steps = 0;
+        while (accumulator >= SIM_TIMESTEP && steps < MAX_SIM_STEPS) {
+            storePreviousSimState();
+            updatePeople(SIM_TIMESTEP);
+            if (currentState == MOVIE || currentState == ENTERING) {
+                updateMovie(SIM_TIMESTEP);
+            }
+            accumulator -= SIM_TIMESTEP;
+            steps++;
+        }
+        simSteps += steps;
+        if (accumulator >= SIM_TIMESTEP) {
+            simDroppedSteps += (long long)(accumulator / SIM_TIMESTEP);
+            accumulator = fmod(accumulator, (double)SIM_TIMESTEP);
         }
 
-        createPeopleWaypoints();
-        currentState = ENTERING;
-        stateStartTime = (float)glfwGetTime();
-        roomLightOn = true;
-        std::cout << "Movie starting! " << numPeople << " of " << occupiedSeats.size() << " viewers entering." << std::endl;
+        if (steps > 0 || changed) publishSimSnapshot(now - accumulator);
+
+        // No precision needed here: oversleeping only means more steps next time.
+        std::this_thread::sleep_for(std::chrono::duration<double>(SIM_TIMESTEP - accumulator));
+    }
+}
+
+void publishSimSnapshot(double stepTime) {
+    SimSnapshot& out = simSnapshots.writeBuffer();
+    out.people.clear();
+    for (const Person& p : people) {
+        out.people.push_back({ p.position, p.previousPosition, p.facingAngle, p.previousFacingAngle,
+                               p.walkCycle, p.humanoidType, p.state, p.active });
     }
+    for (int i = 0; i < TOTAL_SEATS; i++) out.seatStatus[i] = seats[i].status;
+    out.state = currentState;
+    out.doorOpenAmount = doorOpenAmount;
+    out.previousDoorOpenAmount = previousDoorOpenAmount;
+    out.roomLightOn = roomLightOn;
+    out.frameIndex = currentFrameIndex;
+    out.stepTime = stepTime;
+    out.steps = simSteps;
+    out.droppedSteps = simDroppedSteps;
+    out.commandsApplied = simCommandsApplied;
+    simSnapshots.publish();
+}
+
+// Switches frameSnapshot to the newest published snapshot, if there is one;
+// the previous one stays valid until then.
+void consumeSimSnapshot() {
+    simSnapshots.acquire();
+    frameSnapshot = &simSnapshots.readBuffer();
+}
+
+void postSimCommand(SimCommandType type, int value) {
+    if (simCommands.push({ type, value })) {
+        simCommandsPosted++;
+    } else {
+        std::cout << "Simulation input queue full, input dropped." << std::endl;
+    }
+}
+
+void applySimCommand(const SimCommand& command) {
+    switch (command.type) {
+        case SIM_TOGGLE_SEAT: toggleSeat(command.value); break;
+        case SIM_BUY_SEATS:   buySeats(command.value); break;
+        case SIM_START_SHOW:  startShow(); break;
+    }
+}
+
+void toggleSeat(int index) {
+    if (currentState != WAITING) return;
+    if (seats[index].status == FREE) {
+        seats[index].status = RESERVED;
+        std::cout << "Seat [" << seats[index].row << "," << seats[index].col << "] reserved." << std::endl;
+    } else if (seats[index].status == RESERVED) {
+        seats[index].status = FREE;
+        std::cout << "Seat [" << seats[index].row << "," << seats[index].col << "] unreserved." << std::endl;
+    }
+}
+
+void buySeats(int count) {
+    if (currentState != WAITING) return;
+    std::vector<int> indices;
+    if (findNAdjacentSeats(count, indices)) {
+        for (int idx : indices) seats[idx].status = BOUGHT;
+        std::cout << "Bought " << count << " ticket(s)." << std::endl;
+    } else {
+        std::cout << "Cannot find " << count << " adjacent free seats!" << std::endl;
+    }
+}
+
+void startShow() {
+    if (currentState != WAITING) return;
+
+    std::vector<int> occupiedSeats;
+    for (int i = 0; i < TOTAL_SEATS; i++) {
+        if (seats[i].status == RESERVED || seats[i].status == BOUGHT)
+            occupiedSeats.push_back(i);
+    }
+
+    if (occupiedSeats.empty()) {
+        std::cout << "No reserved seats!" << std::endl;
+        return;
+    }
+
+    int numPeople = 1 + rand() % (int)occupiedSeats.size();
+
+    for (int i = (int)occupiedSeats.size() - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        std::swap(occupiedSeats[i], occupiedSeats[j]);
+    }
+
+    people.clear();
+    for (int i = 0; i < numPeople; i++) {
+        Person p;
+        p.assignedSeatIndex = occupiedSeats[i];
+        p.humanoidType = loadedModels.empty() ? 0 : rand() % (int)loadedModels.size();
+        people.push_back(p);
+        seats[occupiedSeats[i]].hasOccupant = true;
+    }
+
+    createPeopleWaypoints();
+    currentState = ENTERING;
+    stateStartTime = (float)glfwGetTime();
+    roomLightOn = true;
+    std::cout << "Movie starting! " << numPeople << " of " << occupiedSeats.size() << " viewers entering." << std::endl;
 }
 
 void updatePeople(float deltaTime) {
@@ -1321,9 +2512,9 @@ void updatePeople(float deltaTime) {
         currentState = WAITING;
         roomLightOn = true;
         people.clear();
-        for (auto& s : seats) {
-            s.status = FREE;
-            s.hasOccupant = false;
+        for (int i = 0; i < TOTAL_SEATS; i++) {
+            seats[i].status = FREE;
+            seats[i].hasOccupant = false;
         }
         std::cout << "All viewers left. Ready for next show." << std::endl;
     }
@@ -1355,79 +2546,137 @@ void updateMovie(float deltaTime) {
     }
 }
 
-void renderScene() {
-    int width, height;
-    GLFWwindow* window = glfwGetCurrentContext();
-    glfwGetFramebufferSize(window, &width, &height);
+// Streams the frame data and queues the 3D scene's draws for a width x height
+// target. Draws nothing, so it can run before the shadow pass.
+void prepareScene(int width, int height) {
     float aspect = (float)width / (float)height;
 
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), aspect, 0.1f, 100.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), aspect, NEAR_PLANE, FAR_PLANE);
     glm::mat4 view = camera.getViewMatrix();
 
-    glUseProgram(basicShader);
-    glUniformMatrix4fv(glGetUniformLocation(basicShader, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(glGetUniformLocation(basicShader, "uView"), 1, GL_FALSE, glm::value_ptr(view));
-
-    glm::vec3 effectiveLightPos = mainLightPos;
-    glm::vec3 effectiveLightColor = roomLightOn ? lightColor : glm::vec3(0.1f);
-
-    if (currentState == MOVIE) {
-
-        effectiveLightPos = glm::vec3(0.0f, ROOM_HEIGHT / 2.0f - 1.0f, -ROOM_DEPTH / 2.0f + 1.5f);
-        effectiveLightColor = glm::vec3(0.4f, 0.4f, 0.5f);
+    glm::vec3 effectiveLightPos, effectiveLightColor;
+    glm::mat4 lightSpace;
+    mainLight(effectiveLightPos, effectiveLightColor, lightSpace);
+
+    FrameData frameData;
+    frameData.projection = projection;
+    frameData.view = view;
+    frameData.lightPos = glm::vec4(effectiveLightPos, 1.0f);
+    frameData.lightColor = glm::vec4(effectiveLightColor, 1.0f);
+    frameData.viewPos = glm::vec4(camera.Position, 1.0f);
+    frameData.lightSpace = lightSpace;
+    frameData.shadowParams = glm::vec4(1.0f, SHADOW_DEPTH_BIAS, 1.0f / SHADOW_MAP_SIZE, 0.0f);
+    RingAllocation frameDataSlot = frameRing.allocate(sizeof(FrameData), frameRing.getUniformAlignment());
+    if (frameDataSlot.data) {
+        memcpy(frameDataSlot.data, &frameData, sizeof(FrameData));
+        frameDataBind(frameRing.id(), (GLintptr)frameDataSlot.offset);
     }
-
-    glUniform3fv(glGetUniformLocation(basicShader, "uLightPos"), 1, glm::value_ptr(effectiveLightPos));
-    glUniform3fv(glGetUniformLocation(basicShader, "uLightColor"), 1, glm::value_ptr(effectiveLightColor));
-    glUniform3fv(glGetUniformLocation(basicShader, "uViewPos"), 1, glm::value_ptr(camera.Position));
-    glUniform1i(glGetUniformLocation(basicShader, "uUseLighting"), 1);
-    glUniform1i(glGetUniformLocation(basicShader, "uUseTexture"), 0);
-    glUniform1f(glGetUniformLocation(basicShader, "uAlpha"), 1.0f);
-
+    viewFrustum.extract(projection * view);
+    // Rasterizes the occluders on the culler's worker while the jobs below run.
+    if (occlusionCullingEnabled) occlusionCuller.beginFrame(projection * view);
+
+    // Light binning, culling, matrices and instance data are jobs; this
+    // thread helps run them, then does all the GL work.
+    JobGroup prepare;
+    frameJobs.run(prepare, [&] {
+        collectSceneLights(sceneLights);
+        clusteredLighting.build(sceneLights, view, glm::radians(camera.Fov), aspect, NEAR_PLANE, FAR_PLANE,
+                                width, height);
+    });
+    frameJobs.run(prepare, prepareSeats);
+    frameJobs.run(prepare, preparePeople);
+    frameJobs.wait(prepare);
+    clusteredLighting.upload();
+    clusteredLighting.bind();
+
+    // The render* functions only queue draw items; the queue decides the order.
+    renderQueue.clear();
     renderRoom();
     renderDecorations();
-    renderDoor();
     renderSeats();
     renderPeople();
-
-    glUseProgram(screenShader);
-    glUniformMatrix4fv(glGetUniformLocation(screenShader, "uProjection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(glGetUniformLocation(screenShader, "uView"), 1, GL_FALSE, glm::value_ptr(view));
     renderScreen();
+}
+
+// Draws the queued scene into the bound framebuffer; the frame ring must be
+// flushed and the shadow map rendered.
+void drawScene() {
+    glState.bindTexture(SHADOW_MAP_UNIT, shadowMaps.getTexture());
+    renderQueue.execute(frameJobs);
+}
 
+// Screen-space overlays, drawn at native resolution after the scene is
+// upscaled. They stream nothing, so they need no flush of their own.
+void renderOverlays() {
+    renderQueue.clear();
     renderCrosshair();
     renderStudentOverlay();
+    renderQueue.execute(frameJobs);
 }
 
-void renderRoom() {
-    glUseProgram(basicShader);
+void bakeCube(GeometryBatch& batch, const glm::vec3& pos, const glm::vec3& scaleVec, const glm::vec3& color) {
+    batch.addMesh(cubeVertices, 36, cubeTransform(pos, scaleVec), color);
+}
+
+void initStaticBatch() {
+    staticBatch.clear();
 
     glm::vec3 wallColor(0.18f, 0.12f, 0.1f);
     glm::vec3 floorColor(0.15f, 0.08f, 0.05f);
     glm::vec3 carpetColor(0.4f, 0.1f, 0.12f);
 
-    drawCube(glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(ROOM_WIDTH + 2.0f, 1.0f, ROOM_DEPTH + 2.0f), floorColor);
+    bakeCube(staticBatch, glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(ROOM_WIDTH + 2.0f, 1.0f, ROOM_DEPTH + 2.0f), floorColor);
 
     float aisleX = getAislePosition(0).x;
-    drawCube(glm::vec3(aisleX, 0.06f, 0.0f), glm::vec3(AISLE_WIDTH + 0.5f, 0.05f, ROOM_DEPTH - 2.0f), carpetColor);
+    bakeCube(staticBatch, glm::vec3(aisleX, 0.06f, 0.0f), glm::vec3(AISLE_WIDTH + 0.5f, 0.05f, ROOM_DEPTH - 2.0f), carpetColor);
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT + 0.5f, 0.0f), glm::vec3(ROOM_WIDTH + 2.0f, 1.0f, ROOM_DEPTH + 2.0f), wallColor);
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT + 0.5f, 0.0f), glm::vec3(ROOM_WIDTH + 2.0f, 1.0f, ROOM_DEPTH + 2.0f), wallColor);
 
     float wallThickness = 1.5f;
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT / 2.0f, -ROOM_DEPTH / 2.0f - wallThickness / 2.0f),
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT / 2.0f, -ROOM_DEPTH / 2.0f - wallThickness / 2.0f),
              glm::vec3(ROOM_WIDTH + 2.0f, ROOM_HEIGHT, wallThickness), wallColor);
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT / 2.0f, ROOM_DEPTH / 2.0f + wallThickness / 2.0f),
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT / 2.0f, ROOM_DEPTH / 2.0f + wallThickness / 2.0f),
              glm::vec3(ROOM_WIDTH + 2.0f, ROOM_HEIGHT, wallThickness), wallColor);
 
-    drawCube(glm::vec3(-ROOM_WIDTH / 2.0f - wallThickness / 2.0f, ROOM_HEIGHT / 2.0f, 0.0f),
+    bakeCube(staticBatch, glm::vec3(-ROOM_WIDTH / 2.0f - wallThickness / 2.0f, ROOM_HEIGHT / 2.0f, 0.0f),
              glm::vec3(wallThickness, ROOM_HEIGHT, ROOM_DEPTH + 2.0f), wallColor);
 
-    drawCube(glm::vec3(ROOM_WIDTH / 2.0f + wallThickness / 2.0f, ROOM_HEIGHT / 2.0f, 0.0f),
+    bakeCube(staticBatch, glm::vec3(ROOM_WIDTH / 2.0f + wallThickness / 2.0f, ROOM_HEIGHT / 2.0f, 0.0f),
              glm::vec3(wallThickness, ROOM_HEIGHT, ROOM_DEPTH + 2.0f), wallColor);
 
-    glDisable(GL_CULL_FACE);
+    glm::vec3 curtainColor(0.5f, 0.08f, 0.1f);
+    float curtainWidth = 2.0f;
+    float screenZ = -ROOM_DEPTH / 2.0f + 0.3f;
+
+    bakeCube(staticBatch, glm::vec3(-SCREEN_WIDTH / 2.0f - curtainWidth / 2.0f - 0.5f, ROOM_HEIGHT / 2.0f, screenZ),
+             glm::vec3(curtainWidth, ROOM_HEIGHT - 2.0f, 0.3f), curtainColor);
+
+    bakeCube(staticBatch, glm::vec3(SCREEN_WIDTH / 2.0f + curtainWidth / 2.0f + 0.5f, ROOM_HEIGHT / 2.0f, screenZ),
+             glm::vec3(curtainWidth, ROOM_HEIGHT - 2.0f, 0.3f), curtainColor);
+
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT - 1.5f, screenZ),
+             glm::vec3(SCREEN_WIDTH + curtainWidth * 2 + 2.0f, 1.5f, 0.4f), curtainColor);
+
+    glm::vec3 fixtureMetal(0.3f, 0.25f, 0.2f);
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT - 0.15f, 0.0f), glm::vec3(1.8f, 0.1f, 1.8f), fixtureMetal);
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT - 0.22f, 0.0f), glm::vec3(1.7f, 0.04f, 0.08f), fixtureMetal);
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT - 0.22f, 0.0f), glm::vec3(0.08f, 0.04f, 1.7f), fixtureMetal);
+
+    glm::vec3 doorPos = DOOR_POSITION;
+    glm::vec3 doorFrameColor(0.45f, 0.30f, 0.20f);
+    bakeCube(staticBatch, doorPos + glm::vec3(-0.65f, 1.25f, 0.1f), glm::vec3(0.18f, 2.5f, 0.4f), doorFrameColor);
+    bakeCube(staticBatch, doorPos + glm::vec3(0.65f, 1.25f, 0.1f), glm::vec3(0.18f, 2.5f, 0.4f), doorFrameColor);
+    bakeCube(staticBatch, doorPos + glm::vec3(0.0f, 2.55f, 0.1f), glm::vec3(1.5f, 0.2f, 0.4f), doorFrameColor);
+
+    glm::vec3 matColor(0.35f, 0.2f, 0.15f);
+    bakeCube(staticBatch, doorPos + glm::vec3(0.0f, 0.02f, 0.6f), glm::vec3(1.8f, 0.03f, 0.8f), matColor);
+
+    staticCulledRange = { 0, staticBatch.size() };
+
+    // Stairs and side fills are drawn without back-face culling.
+    int unculledStart = staticBatch.size();
 
     glm::vec3 stepColor1(0.65f, 0.42f, 0.28f);
     glm::vec3 stepColor2(0.52f, 0.34f, 0.22f);
@@ -1447,36 +2696,36 @@ void renderRoom() {
         float blockH = stepTopY - blockBottom;
         if (blockH > 0.01f) {
             float blockCenterY = blockBottom + blockH / 2.0f;
-            drawCube(glm::vec3(0.0f, blockCenterY, rowZ),
+            bakeCube(staticBatch, glm::vec3(0.0f, blockCenterY, rowZ),
                      glm::vec3(stepWidth, blockH, SEAT_SPACING_Z), stepColor);
         }
 
         float treadH = 0.12f;
-        drawCube(glm::vec3(0.0f, stepTopY + treadH / 2.0f, rowZ),
+        bakeCube(staticBatch, glm::vec3(0.0f, stepTopY + treadH / 2.0f, rowZ),
                  glm::vec3(stepWidth + 0.3f, treadH, SEAT_SPACING_Z + 0.1f), stepColor * 1.15f);
 
         if (row < ROWS - 1) {
             float nextStepTopY = STEP_BASE_Y + (ROWS - 1 - (row + 1)) * ROW_HEIGHT_STEP;
             float rH = stepTopY - nextStepTopY;
-            drawCube(glm::vec3(0.0f, nextStepTopY + rH / 2.0f, frontZ),
+            bakeCube(staticBatch, glm::vec3(0.0f, nextStepTopY + rH / 2.0f, frontZ),
                      glm::vec3(stepWidth + 0.3f, rH + 0.01f, 0.18f), riserColor);
         } else {
 
-            drawCube(glm::vec3(0.0f, stepTopY / 2.0f + 0.02f, frontZ),
+            bakeCube(staticBatch, glm::vec3(0.0f, stepTopY / 2.0f + 0.02f, frontZ),
                      glm::vec3(stepWidth + 0.3f, stepTopY + 0.02f, 0.18f), riserColor);
         }
 
-        drawCube(glm::vec3(0.0f, stepTopY + treadH + 0.01f, frontZ + 0.12f),
+        bakeCube(staticBatch, glm::vec3(0.0f, stepTopY + treadH + 0.01f, frontZ + 0.12f),
                  glm::vec3(stepWidth + 0.3f, 0.07f, 0.16f), edgeColor);
     }
 
     float backRowZ = ROOM_DEPTH / 2.0f - 5.0f + SEAT_SPACING_Z / 2.0f;
     float backStepTopY = STEP_BASE_Y + (ROWS - 1) * ROW_HEIGHT_STEP;
-    drawCube(glm::vec3(0.0f, backStepTopY / 2.0f, backRowZ),
+    bakeCube(staticBatch, glm::vec3(0.0f, backStepTopY / 2.0f, backRowZ),
              glm::vec3(stepWidth + 0.3f, backStepTopY, 0.18f), riserColor);
 
     float fillDepth = ROOM_DEPTH / 2.0f - backRowZ;
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT / 2.0f, backRowZ + fillDepth / 2.0f),
+    bakeCube(staticBatch, glm::vec3(0.0f, ROOM_HEIGHT / 2.0f, backRowZ + fillDepth / 2.0f),
              glm::vec3(stepWidth + 0.3f, ROOM_HEIGHT, fillDepth), wallColor);
 
     float stairsFrontZ = ROOM_DEPTH / 2.0f - 5.0f - (ROWS - 1) * SEAT_SPACING_Z - SEAT_SPACING_Z / 2.0f;
@@ -1484,171 +2733,370 @@ void renderRoom() {
     float stairsZMid = (ROOM_DEPTH / 2.0f + stairsFrontZ) / 2.0f;
     float sideGap = (ROOM_WIDTH - stepWidth) / 2.0f;
 
-    drawCube(glm::vec3(-stepWidth / 2.0f - sideGap / 2.0f, ROOM_HEIGHT / 2.0f, stairsZMid),
+    bakeCube(staticBatch, glm::vec3(-stepWidth / 2.0f - sideGap / 2.0f, ROOM_HEIGHT / 2.0f, stairsZMid),
              glm::vec3(sideGap + 0.3f, ROOM_HEIGHT, stairsZLen), wallColor);
 
-    drawCube(glm::vec3(stepWidth / 2.0f + sideGap / 2.0f, ROOM_HEIGHT / 2.0f, stairsZMid),
+    bakeCube(staticBatch, glm::vec3(stepWidth / 2.0f + sideGap / 2.0f, ROOM_HEIGHT / 2.0f, stairsZMid),
              glm::vec3(sideGap + 0.3f, ROOM_HEIGHT, stairsZLen), wallColor);
 
-    if (cullingEnabled) glEnable(GL_CULL_FACE);
+    staticUnculledRange = { unculledStart, staticBatch.size() - unculledStart };
+    staticBatch.upload(GL_STATIC_DRAW);
 }
 
-void renderDecorations() {
-    glUseProgram(basicShader);
+// The single shadowed light: the ceiling light looking down on the room, or the
+// projector looking out over the audience while the movie runs.
+void mainLight(glm::vec3& position, glm::vec3& color, glm::mat4& lightSpace) {
+    if (frameSnapshot->state == MOVIE) {
+        position = PROJECTOR_LIGHT_POS;
+        color = movieScreenColor() * MOVIE_LIGHT_STRENGTH;
+        lightSpace = glm::perspective(glm::radians(100.0f), 1.0f, 0.5f, 30.0f) *
+                     glm::lookAt(position, position + glm::vec3(0.0f, -0.3f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        return;
+    }
+    position = mainLightPos;
+    color = frameSnapshot->roomLightOn ? lightColor : glm::vec3(0.1f);
+    lightSpace = glm::perspective(glm::radians(120.0f), 1.0f, 0.5f, 30.0f) *
+                 glm::lookAt(position, position - glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+}
 
-    glm::vec3 curtainColor(0.5f, 0.08f, 0.1f);
-    float curtainWidth = 2.0f;
-    float screenZ = -ROOM_DEPTH / 2.0f + 0.3f;
+void initShadows() {
+    shadowMaps.create(SHADOW_MAP_SIZE);
 
-    drawCube(glm::vec3(-SCREEN_WIDTH / 2.0f - curtainWidth / 2.0f - 0.5f, ROOM_HEIGHT / 2.0f, screenZ),
-             glm::vec3(curtainWidth, ROOM_HEIGHT - 2.0f, 0.3f), curtainColor);
+    // Every seat, unlike the frame ring's per-frame seat stream, which holds
+    // only the visible ones (visibleSeatInstances).
+    shadowSeatInstances.create(seatInstanceData.size());
+    shadowSeatInstances.upload(seatInstanceData.data(), 0, seatInstanceData.size());
+    glGenVertexArrays(1, &shadowSeatVAO);
+    glBindVertexArray(shadowSeatVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    shadowSeatInstances.attach(shadowSeatVAO);
+}
 
-    drawCube(glm::vec3(SCREEN_WIDTH / 2.0f + curtainWidth / 2.0f + 0.5f, ROOM_HEIGHT / 2.0f, screenZ),
-             glm::vec3(curtainWidth, ROOM_HEIGHT - 2.0f, 0.3f), curtainColor);
+void drawPersonShadow(const PersonSnapshot& person) {
+    if (person.humanoidType < 0 || person.humanoidType >= (int)loadedModels.size()) return;
+    const MeshAllocation& geometry = loadedModels[person.humanoidType].geometry;
+    shadowShader.setMat4(UNIFORM_MODEL, personTransform(person));
+    glDrawElementsBaseVertex(GL_TRIANGLES, geometry.indexCount, GL_UNSIGNED_INT,
+                             (void*)(geometry.firstIndex * sizeof(uint32_t)), geometry.baseVertex);
+    profilerAdd(PROF_SHADOW_CASTERS);
+}
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT - 1.5f, screenZ),
-             glm::vec3(SCREEN_WIDTH + curtainWidth * 2 + 2.0f, 1.5f, 0.4f), curtainColor);
+// Re-renders the static layer only when the light or a static caster changed,
+// then draws the people currently walking into the dynamic layer.
+void renderShadows() {
+    glm::vec3 lightPos, lightCol;
+    glm::mat4 lightSpace;
+    mainLight(lightPos, lightCol, lightSpace);
+    shadowMaps.beginFrame(lightSpace);
+
+    unsigned long long seatedCount = 0;
+    shadowMovers.clear();
+    const SimSnapshot& sim = *frameSnapshot;
+    for (const auto& p : sim.people) {
+        if (!p.active || p.state == EXITED) continue;
+        if (p.state == SEATED) seatedCount++;
+        else shadowMovers.push_back(&p);
+    }
+    unsigned long long key = (sim.roomLightOn ? 1ull : 0ull) | ((unsigned long long)sim.state << 1) |
+                             (seatedCount << 4) | ((unsigned long long)(doorRenderAmount() * 1000.0f) << 16);
+
+    bool staticDirty = shadowMaps.needsStaticUpdate(key);
+    if (!staticDirty && shadowMovers.empty()) return;
+
+    glState.setEnabled(GL_CULL_FACE, false);
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.setEnabled(GL_POLYGON_OFFSET_FILL, true);
+    glPolygonOffset(2.0f, 4.0f);
+
+    if (staticDirty) {
+        shadowMaps.beginStatic(key);
+        shadowShader.use();
+        shadowShader.setMat4(UNIFORM_LIGHT_SPACE, lightSpace);
+        shadowShader.setMat4(UNIFORM_MODEL, glm::mat4(1.0f));
+        glState.bindVertexArray(staticBatch.getVAO());
+        glDrawArrays(GL_TRIANGLES, 0, staticBatch.size());
+        if (dynamicBatchFirst >= 0) {
+            glState.bindVertexArray(dynamicBatchVAO);
+            glDrawArrays(GL_TRIANGLES, dynamicBatchFirst, dynamicBatch.size());
+        }
 
-    glm::vec3 exitSignColor(0.8f, 0.1f, 0.1f);
-    if (roomLightOn) exitSignColor = glm::vec3(1.0f, 0.2f, 0.2f);
-    drawCube(DOOR_POSITION + glm::vec3(0.0f, 3.2f, 0.2f), glm::vec3(1.2f, 0.4f, 0.1f), exitSignColor);
+        glState.bindVertexArray(modelMeshes.getVAO());
+        for (const auto& p : sim.people) {
+            if (p.active && p.state == SEATED) drawPersonShadow(p);
+        }
 
-    glm::vec3 sconceLightColor = roomLightOn ? glm::vec3(1.0f, 0.9f, 0.7f) : glm::vec3(0.3f, 0.25f, 0.2f);
-    for (int i = 0; i < 3; i++) {
-        float z = ROOM_DEPTH / 4.0f - i * ROOM_DEPTH / 3.0f;
-        drawCube(glm::vec3(-ROOM_WIDTH / 2.0f + 0.3f, ROOM_HEIGHT * 0.6f, z), glm::vec3(0.2f, 0.4f, 0.15f), sconceLightColor);
-        drawCube(glm::vec3(ROOM_WIDTH / 2.0f - 0.3f, ROOM_HEIGHT * 0.6f, z), glm::vec3(0.2f, 0.4f, 0.15f), sconceLightColor);
+        shadowInstancedShader.use();
+        shadowInstancedShader.setMat4(UNIFORM_LIGHT_SPACE, lightSpace);
+        glState.bindVertexArray(shadowSeatVAO);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 36, (GLsizei)seatInstanceData.size());
+        profilerAdd(PROF_SHADOW_CASTERS, 2 + (long long)seatInstanceData.size());
     }
 
-    glm::vec3 fixtureMetal(0.3f, 0.25f, 0.2f);
-    glm::vec3 bulbColor = roomLightOn ? glm::vec3(1.0f, 0.95f, 0.8f) : glm::vec3(0.15f, 0.12f, 0.1f);
+    if (!shadowMovers.empty()) {
+        shadowMaps.beginDynamic();
+        shadowShader.use();
+        shadowShader.setMat4(UNIFORM_LIGHT_SPACE, lightSpace);
+        glState.bindVertexArray(modelMeshes.getVAO());
+        for (const PersonSnapshot* p : shadowMovers) drawPersonShadow(*p);
+    }
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT - 0.15f, 0.0f), glm::vec3(1.8f, 0.1f, 1.8f), fixtureMetal);
+    glState.setEnabled(GL_POLYGON_OFFSET_FILL, false);
+    shadowMaps.end();
+}
 
-    glUniform1i(glGetUniformLocation(basicShader, "uUseLighting"), 0);
+// The light-emitting decorations as point lights. Positions match the cubes
+// baked in updateDynamicBatch and initStaticBatch.
+void collectSceneLights(std::vector<PointLight>& lights) {
+    lights.clear();
+    bool roomLightOn = frameSnapshot->roomLightOn;
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT - 0.25f, 0.0f), glm::vec3(1.5f, 0.08f, 1.5f), bulbColor);
+    float sconceIntensity = roomLightOn ? 0.6f : 0.2f;
+    glm::vec3 sconceColor = glm::vec3(1.0f, 0.85f, 0.6f) * sconceIntensity;
+    for (int i = 0; i < 3; i++) {
+        float z = ROOM_DEPTH / 4.0f - i * ROOM_DEPTH / 3.0f;
+        lights.push_back({ glm::vec3(-ROOM_WIDTH / 2.0f + 0.6f, ROOM_HEIGHT * 0.6f, z), 5.0f, sconceColor });
+        lights.push_back({ glm::vec3(ROOM_WIDTH / 2.0f - 0.6f, ROOM_HEIGHT * 0.6f, z), 5.0f, sconceColor });
+    }
 
     if (roomLightOn) {
-        drawCube(glm::vec3(0.0f, ROOM_HEIGHT - 0.3f, 0.0f), glm::vec3(0.8f, 0.06f, 0.8f), glm::vec3(1.0f, 1.0f, 0.95f));
+        lights.push_back({ glm::vec3(0.0f, ROOM_HEIGHT - 0.5f, 0.0f), 9.0f, glm::vec3(0.5f, 0.45f, 0.35f) });
     }
 
-    glUniform1i(glGetUniformLocation(basicShader, "uUseLighting"), 1);
+    glm::vec3 exitSignColor = roomLightOn ? glm::vec3(0.6f, 0.1f, 0.1f) : glm::vec3(0.8f, 0.12f, 0.12f);
+    lights.push_back({ DOOR_POSITION + glm::vec3(0.0f, 3.0f, 0.6f), 3.5f, exitSignColor });
+
+    // Light spilling off the screen onto the front rows while the movie runs.
+    if (frameSnapshot->state == MOVIE) {
+        float screenZ = -ROOM_DEPTH / 2.0f + 0.3f;
+        glm::vec3 spillColor = movieScreenColor() * SCREEN_SPILL_STRENGTH;
+        for (int i = -1; i <= 1; i++) {
+            lights.push_back({ glm::vec3(i * SCREEN_WIDTH / 3.0f, ROOM_HEIGHT / 2.0f, screenZ + 1.5f), 12.0f,
+                               spillColor });
+        }
+    }
 
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT - 0.22f, 0.0f), glm::vec3(1.7f, 0.04f, 0.08f), fixtureMetal);
-    drawCube(glm::vec3(0.0f, ROOM_HEIGHT - 0.22f, 0.0f), glm::vec3(0.08f, 0.04f, 1.7f), fixtureMetal);
+    lights.insert(lights.end(), benchmarkLights.begin(), benchmarkLights.end());
 }
 
-void renderDoor() {
-    glUseProgram(basicShader);
+// Door panels and light-state colours; rebuilt only when the door moves or the
+// room light is switched.
+void updateDynamicBatch() {
+    float doorAmount = doorRenderAmount();
+    bool roomLightOn = frameSnapshot->roomLightOn;
+    if (doorAmount == dynamicBatchDoorAmount && roomLightOn == dynamicBatchLightOn) return;
+    dynamicBatchDoorAmount = doorAmount;
+    dynamicBatchLightOn = roomLightOn;
+    dynamicBatch.clear();
+
+    glm::vec3 exitSignColor(0.8f, 0.1f, 0.1f);
+    if (roomLightOn) exitSignColor = glm::vec3(1.0f, 0.2f, 0.2f);
+    bakeCube(dynamicBatch, DOOR_POSITION + glm::vec3(0.0f, 3.2f, 0.2f), glm::vec3(1.2f, 0.4f, 0.1f), exitSignColor);
+
+    glm::vec3 sconceLightColor = roomLightOn ? glm::vec3(1.0f, 0.9f, 0.7f) : glm::vec3(0.3f, 0.25f, 0.2f);
+    for (int i = 0; i < 3; i++) {
+        float z = ROOM_DEPTH / 4.0f - i * ROOM_DEPTH / 3.0f;
+        bakeCube(dynamicBatch, glm::vec3(-ROOM_WIDTH / 2.0f + 0.3f, ROOM_HEIGHT * 0.6f, z), glm::vec3(0.2f, 0.4f, 0.15f), sconceLightColor);
+        bakeCube(dynamicBatch, glm::vec3(ROOM_WIDTH / 2.0f - 0.3f, ROOM_HEIGHT * 0.6f, z), glm::vec3(0.2f, 0.4f, 0.15f), sconceLightColor);
+    }
 
     glm::vec3 doorPos = DOOR_POSITION;
-    glm::vec3 doorFrameColor(0.45f, 0.30f, 0.20f);
     glm::vec3 doorColor(0.65f, 0.40f, 0.25f);
     glm::vec3 doorHandleColor(0.85f, 0.75f, 0.45f);
+    float doorSlide = doorAmount * 0.7f;
 
-    drawCube(doorPos + glm::vec3(-0.65f, 1.25f, 0.1f), glm::vec3(0.18f, 2.5f, 0.4f), doorFrameColor);
-
-    drawCube(doorPos + glm::vec3(0.65f, 1.25f, 0.1f), glm::vec3(0.18f, 2.5f, 0.4f), doorFrameColor);
-
-    drawCube(doorPos + glm::vec3(0.0f, 2.55f, 0.1f), glm::vec3(1.5f, 0.2f, 0.4f), doorFrameColor);
-
-    float doorSlide = doorOpenAmount * 0.7f;
-
-    drawCube(doorPos + glm::vec3(-0.3f - doorSlide, 1.2f, 0.15f),
+    bakeCube(dynamicBatch, doorPos + glm::vec3(-0.3f - doorSlide, 1.2f, 0.15f),
              glm::vec3(0.55f, 2.3f, 0.12f), doorColor);
 
-    drawCube(doorPos + glm::vec3(0.3f + doorSlide, 1.2f, 0.15f),
+    bakeCube(dynamicBatch, doorPos + glm::vec3(0.3f + doorSlide, 1.2f, 0.15f),
              glm::vec3(0.55f, 2.3f, 0.12f), doorColor);
 
-    if (doorOpenAmount < 0.9f) {
-        drawCube(doorPos + glm::vec3(-0.08f - doorSlide, 1.1f, 0.25f),
+    if (doorAmount < 0.9f) {
+        bakeCube(dynamicBatch, doorPos + glm::vec3(-0.08f - doorSlide, 1.1f, 0.25f),
                  glm::vec3(0.12f, 0.06f, 0.08f), doorHandleColor);
-        drawCube(doorPos + glm::vec3(0.08f + doorSlide, 1.1f, 0.25f),
+        bakeCube(dynamicBatch, doorPos + glm::vec3(0.08f + doorSlide, 1.1f, 0.25f),
                  glm::vec3(0.12f, 0.06f, 0.08f), doorHandleColor);
     }
 
     glm::vec3 signColor = roomLightOn ? glm::vec3(1.0f, 0.3f, 0.3f) : glm::vec3(0.5f, 0.1f, 0.1f);
-    drawCube(doorPos + glm::vec3(0.0f, 2.8f, 0.15f), glm::vec3(1.2f, 0.3f, 0.1f), signColor);
+    bakeCube(dynamicBatch, doorPos + glm::vec3(0.0f, 2.8f, 0.15f), glm::vec3(1.2f, 0.3f, 0.1f), signColor);
 
-    glm::vec3 matColor(0.35f, 0.2f, 0.15f);
-    drawCube(doorPos + glm::vec3(0.0f, 0.02f, 0.6f), glm::vec3(1.8f, 0.03f, 0.8f), matColor);
-}
-
-void renderSeats() {
-    glUseProgram(basicShader);
+    dynamicLitRange = { 0, dynamicBatch.size() };
 
-    bool wasCulling = cullingEnabled;
-    if (wasCulling) {
-        glDisable(GL_CULL_FACE);
+    glm::vec3 bulbColor = roomLightOn ? glm::vec3(1.0f, 0.95f, 0.8f) : glm::vec3(0.15f, 0.12f, 0.1f);
+    bakeCube(dynamicBatch, glm::vec3(0.0f, ROOM_HEIGHT - 0.25f, 0.0f), glm::vec3(1.5f, 0.08f, 1.5f), bulbColor);
+    if (roomLightOn) {
+        bakeCube(dynamicBatch, glm::vec3(0.0f, ROOM_HEIGHT - 0.3f, 0.0f), glm::vec3(0.8f, 0.06f, 0.8f), glm::vec3(1.0f, 1.0f, 0.95f));
     }
 
-    for (const auto& seat : seats) {
-        glm::vec3 fabricColor, frameColor;
+    dynamicUnlitRange = { dynamicLitRange.count, dynamicBatch.size() - dynamicLitRange.count };
+}
 
-        switch (seat.status) {
-            case FREE:     fabricColor = glm::vec3(0.15f, 0.25f, 0.5f); break;
-            case RESERVED: fabricColor = glm::vec3(0.7f, 0.6f, 0.1f); break;
-            case BOUGHT:   fabricColor = glm::vec3(0.6f, 0.15f, 0.15f); break;
-        }
-        frameColor = glm::vec3(0.2f, 0.15f, 0.1f);
+// Writes the dynamic batch into this frame's ring space before the shadow
+// pass and the scene draw it.
+void streamDynamicBatch() {
+    updateDynamicBatch();
+    const std::vector<BatchVertex>& vertices = dynamicBatch.getVertices();
+    size_t bytes = vertices.size() * sizeof(BatchVertex);
+    RingAllocation allocation = frameRing.allocate(bytes, sizeof(BatchVertex));
+    dynamicBatchFirst = -1;
+    if (!allocation.data) return;
+    memcpy(allocation.data, vertices.data(), bytes);
+    dynamicBatchFirst = (int)(allocation.offset / sizeof(BatchVertex));
+}
+
+int sceneDrawFlags() {
+    return (cullingEnabled ? DRAW_CULL_FACE : 0) | (depthTestEnabled ? DRAW_DEPTH_TEST : 0);
+}
 
-        drawCube(seat.position + glm::vec3(0.0f, 0.05f, 0.0f),
-                 glm::vec3(SEAT_SIZE + 0.1f, 0.1f, SEAT_SIZE + 0.1f), frameColor);
+void renderRoom() {
+    int features = BASIC_FEATURE_LIGHTING | BASIC_FEATURE_VERTEX_COLOR;
+    if (bakedLightingEnabled) features |= BASIC_FEATURE_BAKED_LIGHTING;
+    DrawItem item = basicDrawItem(features);
+    if (bakedLightingEnabled) {
+        // Only one baked light is lit at a time; its weight is the light colour.
+        glm::vec3 lightPos, lightCol;
+        glm::mat4 lightSpace;
+        mainLight(lightPos, lightCol, lightSpace);
+        bool projector = frameSnapshot->state == MOVIE;
+        item.setVec3(UNIFORM_BAKED_ROOM_LIGHT, projector ? glm::vec3(0.0f) : lightCol);
+        item.setVec3(UNIFORM_BAKED_PROJECTOR_LIGHT, projector ? lightCol : glm::vec3(0.0f));
+    }
+    item.vao = staticBatch.getVAO();
+    item.flags = sceneDrawFlags();
+    // Batch vertices are already in world space.
+    item.setModel(glm::mat4(1.0f));
+    item.first = staticCulledRange.first;
+    item.count = staticCulledRange.count;
+    renderQueue.submit(PASS_OPAQUE, 0.0f, item);
+
+    item.flags &= ~DRAW_CULL_FACE;
+    item.first = staticUnculledRange.first;
+    item.count = staticUnculledRange.count;
+    renderQueue.submit(PASS_OPAQUE, 0.0f, item);
+}
 
-        drawCube(seat.position + glm::vec3(0.0f, SEAT_SIZE / 4.0f + 0.05f, -0.05f),
-                 glm::vec3(SEAT_SIZE - 0.05f, SEAT_SIZE / 2.5f, SEAT_SIZE - 0.1f), fabricColor);
+void renderDecorations() {
+    if (dynamicBatchFirst < 0) return;
+
+    DrawItem lit = basicDrawItem(BASIC_FEATURE_LIGHTING | BASIC_FEATURE_VERTEX_COLOR);
+    lit.vao = dynamicBatchVAO;
+    lit.flags = sceneDrawFlags();
+    lit.setModel(glm::mat4(1.0f));
+    lit.first = dynamicBatchFirst + dynamicLitRange.first;
+    lit.count = dynamicLitRange.count;
+    renderQueue.submit(PASS_OPAQUE, 0.0f, lit);
+
+    DrawItem unlit = basicDrawItem(BASIC_FEATURE_VERTEX_COLOR);
+    unlit.vao = dynamicBatchVAO;
+    unlit.flags = sceneDrawFlags();
+    unlit.setModel(glm::mat4(1.0f));
+    unlit.first = dynamicBatchFirst + dynamicUnlitRange.first;
+    unlit.count = dynamicUnlitRange.count;
+    renderQueue.submit(PASS_OPAQUE, 0.0f, unlit);
+}
 
-        drawCube(seat.position + glm::vec3(0.0f, SEAT_SIZE * 0.7f, SEAT_SIZE / 2.0f - 0.08f),
-                 glm::vec3(SEAT_SIZE - 0.05f, SEAT_SIZE * 0.9f, 0.12f), fabricColor * 0.9f);
+// Job: rebuilds the instances of seats whose status changed, culls the seats
+// and packs the visible ones' instances for renderSeats to stream.
+void prepareSeats() {
+    bool changed = false;
+    for (int i = 0; i < (int)seats.size(); i++) {
+        SeatStatus status = frameSnapshot->seatStatus[i];
+        if (status == builtSeatStatus[i]) continue;
+        buildSeatInstances(seats[i], status, &seatInstanceData[(size_t)i * SEAT_PARTS]);
+        builtSeatStatus[i] = status;
+        changed = true;
+    }
 
-        glm::vec3 armrestColor(0.15f, 0.1f, 0.08f);
-        drawCube(seat.position + glm::vec3(-SEAT_SIZE / 2.0f - 0.08f, SEAT_SIZE * 0.4f, 0.0f),
-                 glm::vec3(0.1f, 0.08f, SEAT_SIZE * 0.7f), armrestColor);
-        drawCube(seat.position + glm::vec3(SEAT_SIZE / 2.0f + 0.08f, SEAT_SIZE * 0.4f, 0.0f),
-                 glm::vec3(0.1f, 0.08f, SEAT_SIZE * 0.7f), armrestColor);
+    visibleSeats.clear();
+    for (int i = 0; i < (int)seats.size(); i++) {
+        if (viewFrustum.isVisible(seatBounds(seats[i]))) visibleSeats.push_back(i);
     }
 
-    if (wasCulling) {
-        glEnable(GL_CULL_FACE);
+    // The visible set only changes when the camera turns, so most frames
+    // reuse the previous packing.
+    if (changed || visibleSeats != packedSeats) {
+        visibleSeatInstances.clear();
+        for (int index : visibleSeats) {
+            const InstanceData* parts = &seatInstanceData[(size_t)index * SEAT_PARTS];
+            visibleSeatInstances.insert(visibleSeatInstances.end(), parts, parts + SEAT_PARTS);
+        }
+        packedSeats = visibleSeats;
     }
 }
 
-void renderScreen() {
-    glUseProgram(screenShader);
+void renderSeats() {
+    profilerAdd(PROF_CULL_VISIBLE, (long long)visibleSeats.size());
+    profilerAdd(PROF_CULL_CULLED, (long long)(seats.size() - visibleSeats.size()));
+    if (visibleSeats.empty()) return;
+    GLuint baseInstance;
+    if (!streamInstances(visibleSeatInstances, baseInstance)) return;
+
+    DrawItem item = basicDrawItem(BASIC_FEATURE_LIGHTING | BASIC_FEATURE_INSTANCED);
+    item.vao = seatVAO;
+    item.flags = sceneDrawFlags() & ~DRAW_CULL_FACE;
+    item.count = 36;
+    item.instances = (GLsizei)(visibleSeats.size() * SEAT_PARTS);
+    item.baseInstance = baseInstance;
+    item.instanceBuffer = frameRing.id();
+    renderQueue.submit(PASS_OPAQUE, 0.0f, item);
+}
 
+void renderScreen() {
+    glm::vec3 screenPos(0.0f, ROOM_HEIGHT / 2.0f - 1.0f, -ROOM_DEPTH / 2.0f + 0.15f);
     glm::mat4 model(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, ROOM_HEIGHT / 2.0f - 1.0f, -ROOM_DEPTH / 2.0f + 0.15f));
+    model = glm::translate(model, screenPos);
     model = glm::scale(model, glm::vec3(SCREEN_WIDTH, SCREEN_HEIGHT, 1.0f));
 
-    glUniformMatrix4fv(glGetUniformLocation(screenShader, "uModel"), 1, GL_FALSE, glm::value_ptr(model));
-
-    if (currentState == MOVIE && !frameTextures.empty()) {
-        glUniform1i(glGetUniformLocation(screenShader, "uUseTexture"), 1);
-        glUniform1f(glGetUniformLocation(screenShader, "uEmissionStrength"), 0.8f);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, frameTextures[currentFrameIndex]);
-        glUniform1i(glGetUniformLocation(screenShader, "uTexture"), 0);
-    } else if (currentState == MOVIE) {
-        glUniform1i(glGetUniformLocation(screenShader, "uUseTexture"), 0);
-        glUniform1f(glGetUniformLocation(screenShader, "uEmissionStrength"), 0.6f);
-        float t = (float)glfwGetTime();
-        glUniform3f(glGetUniformLocation(screenShader, "uEmissionColor"),
-            0.5f + 0.5f * sinf(t * 2.0f),
-            0.5f + 0.5f * sinf(t * 2.5f + 1.0f),
-            0.5f + 0.5f * sinf(t * 3.0f + 2.0f));
+    AABB quadBounds = { glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(0.5f, 0.5f, 0.0f) };
+    if (!viewFrustum.isVisible(transformAABB(quadBounds, model))) {
+        profilerAdd(PROF_CULL_CULLED);
+        return;
+    }
+    profilerAdd(PROF_CULL_VISIBLE);
+
+    DrawItem item;
+    item.program = &screenShader;
+    item.vao = quadVAO;
+    item.flags = sceneDrawFlags();
+    item.count = 6;
+    item.setModel(model);
+
+    AppState state = frameSnapshot->state;
+    if (state == MOVIE && !frameTextures.empty()) {
+        int frameIndex = frameSnapshot->frameIndex;
+        item.setInt(UNIFORM_USE_TEXTURE, 1);
+        item.setFloat(UNIFORM_EMISSION_STRENGTH, 0.8f);
+        textureResidency.touch(frameTextures[frameIndex]);
+        item.texture = frameTextures[frameIndex];
+    } else if (state == MOVIE) {
+        item.setInt(UNIFORM_USE_TEXTURE, 0);
+        item.setFloat(UNIFORM_EMISSION_STRENGTH, 0.6f);
+        item.setVec3(UNIFORM_EMISSION_COLOR, movieScreenColor());
     } else {
-        glUniform1i(glGetUniformLocation(screenShader, "uUseTexture"), 0);
-        glUniform1f(glGetUniformLocation(screenShader, "uEmissionStrength"), 0.05f);
-        glUniform3f(glGetUniformLocation(screenShader, "uEmissionColor"), 0.85f, 0.85f, 0.85f);
+        item.setInt(UNIFORM_USE_TEXTURE, 0);
+        item.setFloat(UNIFORM_EMISSION_STRENGTH, 0.05f);
+        item.setVec3(UNIFORM_EMISSION_COLOR, glm::vec3(0.85f, 0.85f, 0.85f));
     }
 
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    renderQueue.submit(PASS_OPAQUE, glm::length(screenPos - camera.Position), item);
+}
+
+// Mean colour of what the screen shows right now: the current frame's,
+// averaged when it was decoded, or the colour cycle used without frames.
+glm::vec3 movieScreenColor() {
+    if (!frameAverageColors.empty()) return frameAverageColors[frameSnapshot->frameIndex % frameAverageColors.size()];
+    float t = (float)glfwGetTime();
+    return glm::vec3(0.5f + 0.5f * sinf(t * 2.0f),
+                     0.5f + 0.5f * sinf(t * 2.5f + 1.0f),
+                     0.5f + 0.5f * sinf(t * 3.0f + 2.0f));
 }
 
 void renderPeople() {
+    const std::vector<PersonSnapshot>& people = frameSnapshot->people;
     if (people.empty()) return;
 
     int visibleCount = 0;
@@ -1661,121 +3109,142 @@ void renderPeople() {
         std::cout << "Rendering " << visibleCount << " people" << std::endl;
     }
 
-    bool wasCulling = cullingEnabled;
-    if (wasCulling) {
-        glDisable(GL_CULL_FACE);
+    for (size_t i = 0; i < crowdInstanceData.size(); i++) {
+        crowdInstanceData[i].clear();
+        crowdNearestDepth[i] = 1e30f;
     }
 
-    for (const auto& p : people) {
-        if (p.state == EXITED || !p.active) continue;
-        renderHumanoid(p);
+    for (const PreparedPerson& prepared : preparedPeople) {
+        switch (prepared.visibility) {
+            case PERSON_ABSENT: continue;
+            case PERSON_CULLED: profilerAdd(PROF_CULL_CULLED); continue;
+            case PERSON_OCCLUDED: profilerAdd(PROF_OCCLUSION_CULLED); continue;
+            case PERSON_VISIBLE: break;
+        }
+        profilerAdd(PROF_CULL_VISIBLE);
+        int type = prepared.type;
+        crowdInstanceData[type].push_back(prepared.instance);
+        if (prepared.depth < crowdNearestDepth[type]) crowdNearestDepth[type] = prepared.depth;
     }
 
-    if (wasCulling) {
-        glEnable(GL_CULL_FACE);
+    crowdPacked.clear();
+    for (const auto& instances : crowdInstanceData) {
+        crowdPacked.insert(crowdPacked.end(), instances.begin(), instances.end());
     }
-}
-
-void renderHumanoid(const Person& person) {
-    if (person.humanoidType < 0 || person.humanoidType >= (int)loadedModels.size()) return;
-
-    Model3D& model = loadedModels[person.humanoidType];
-
-    glm::mat4 modelMat(1.0f);
-    modelMat = glm::translate(modelMat, person.position);
-    modelMat = glm::rotate(modelMat, person.facingAngle, glm::vec3(0.0f, 1.0f, 0.0f));
-
-    modelMat = glm::scale(modelMat, glm::vec3(model.normalizeScale));
-    modelMat = glm::translate(modelMat, model.centerOffset);
-
-    for (auto& mesh : model.meshes) {
-        glUniformMatrix4fv(glGetUniformLocation(basicShader, "uModel"), 1, GL_FALSE, glm::value_ptr(modelMat));
+    if (crowdPacked.empty()) return;
+    GLuint baseInstance;
+    if (!streamInstances(crowdPacked, baseInstance)) return;
+
+    // One instanced draw per model and texture array, however many people and
+    // material groups it has.
+    for (size_t type = 0; type < crowdInstanceData.size(); type++) {
+        GLsizei instanceCount = (GLsizei)crowdInstanceData[type].size();
+        if (instanceCount == 0) continue;
+
+        const Model3D& model = loadedModels[type];
+        for (const MaterialRange& range : model.materials) {
+            DrawItem item = basicDrawItem(BASIC_FEATURE_LIGHTING | BASIC_FEATURE_INSTANCED |
+                                          BASIC_FEATURE_MATERIAL_ARRAY);
+            item.vao = modelMeshes.getVAO();
+            item.flags = (sceneDrawFlags() & ~DRAW_CULL_FACE) | DRAW_INDEXED;
+            item.first = (GLint)(model.geometry.firstIndex + range.firstIndex);
+            item.count = (GLsizei)range.indexCount;
+            item.baseVertex = model.geometry.baseVertex;
+            item.instances = instanceCount;
+            item.baseInstance = baseInstance;
+            item.instanceBuffer = frameRing.id();
+            if (range.textures) {
+                textureResidency.touch(range.textures);
+                item.texture = range.textures;
+                item.textureUnit = MATERIAL_TEXTURE_UNIT;
+                item.textureTarget = GL_TEXTURE_2D_ARRAY;
+            }
 
-        if (mesh.diffuseTexture) {
-            glUniform1i(glGetUniformLocation(basicShader, "uUseTexture"), 1);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, mesh.diffuseTexture);
-            glUniform1i(glGetUniformLocation(basicShader, "uTexture"), 0);
-        } else {
-            glUniform1i(glGetUniformLocation(basicShader, "uUseTexture"), 0);
-            glUniform3fv(glGetUniformLocation(basicShader, "uColor"), 1, glm::value_ptr(mesh.diffuseColor));
+            renderQueue.submit(PASS_OPAQUE, crowdNearestDepth[type], item);
         }
-
-        glBindVertexArray(mesh.VAO);
-        glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount);
+        baseInstance += (GLuint)instanceCount;
     }
-    glBindVertexArray(0);
 }
 
-void renderCrosshair() {
-    if (currentState != WAITING) return;
-
-    glDisable(GL_DEPTH_TEST);
-    glUseProgram(overlayShader);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, crosshairTexture);
-    glUniform1i(glGetUniformLocation(overlayShader, "uTexture"), 0);
-    glUniform1f(glGetUniformLocation(overlayShader, "uAlpha"), 0.85f);
-
-    glBindVertexArray(overlayVAO);
-
-    glUniform2f(glGetUniformLocation(overlayShader, "uPos"), 0.0f, 0.0f);
-    glUniform2f(glGetUniformLocation(overlayShader, "uSize"), 0.05f, 0.05f);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-
-    glBindVertexArray(0);
-    if (depthTestEnabled) glEnable(GL_DEPTH_TEST);
+// Job: culls and transforms every person of the frame's snapshot. Waits for
+// the occlusion buffer first; the culler's worker fills it meanwhile.
+void preparePeople() {
+    const std::vector<PersonSnapshot>& people = frameSnapshot->people;
+    preparedPeople.resize(people.size());
+    if (occlusionCullingEnabled) occlusionCuller.finish();
+    frameJobs.parallelFor((int)people.size(), PEOPLE_JOB_CHUNK, [&people](int begin, int end) {
+        for (int i = begin; i < end; i++) prepareHumanoid(people[i], preparedPeople[i]);
+    });
 }
 
-void renderStudentOverlay() {
-    if (!studentTexture) return;
-
-    glDisable(GL_DEPTH_TEST);
-    glUseProgram(overlayShader);
-
-    glUniform2f(glGetUniformLocation(overlayShader, "uPos"), 0.78f, -0.78f);
-    glUniform2f(glGetUniformLocation(overlayShader, "uSize"), 0.35f, 0.35f);
-    glUniform1f(glGetUniformLocation(overlayShader, "uAlpha"), 0.6f);
+void prepareHumanoid(const PersonSnapshot& person, PreparedPerson& out) {
+    out.visibility = PERSON_ABSENT;
+    if (person.state == EXITED || !person.active) return;
+    if (person.humanoidType < 0 || person.humanoidType >= (int)loadedModels.size()) return;
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, studentTexture);
-    glUniform1i(glGetUniformLocation(overlayShader, "uTexture"), 0);
+    const Model3D& model = loadedModels[person.humanoidType];
+    glm::mat4 modelMat = personTransform(person);
 
-    glBindVertexArray(overlayVAO);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-    glBindVertexArray(0);
+    AABB localBounds = { model.boundsMin, model.boundsMax };
+    AABB worldBounds = transformAABB(localBounds, modelMat);
+    if (!viewFrustum.isVisible(worldBounds)) {
+        out.visibility = PERSON_CULLED;
+        return;
+    }
+    if (occlusionCullingEnabled && occlusionCuller.isOccluded(worldBounds)) {
+        out.visibility = PERSON_OCCLUDED;
+        return;
+    }
 
-    if (depthTestEnabled) glEnable(GL_DEPTH_TEST);
+    out.visibility = PERSON_VISIBLE;
+    out.type = person.humanoidType;
+    out.depth = glm::length(personRenderPosition(person) - camera.Position);
+    out.instance = makeInstanceData(modelMat, glm::vec3(1.0f));
 }
 
-void drawCube(const glm::vec3& pos, const glm::vec3& scaleVec, const glm::vec3& color) {
-    glm::mat4 model(1.0f);
-    model = glm::translate(model, pos);
-    model = glm::scale(model, scaleVec);
-
-    glUniformMatrix4fv(glGetUniformLocation(basicShader, "uModel"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3fv(glGetUniformLocation(basicShader, "uColor"), 1, glm::value_ptr(color));
-    glUniform1i(glGetUniformLocation(basicShader, "uUseTexture"), 0);
+glm::mat4 personTransform(const PersonSnapshot& person) {
+    const Model3D& model = loadedModels[person.humanoidType];
+    glm::mat4 modelMat(1.0f);
+    modelMat = glm::translate(modelMat, personRenderPosition(person));
+    modelMat = glm::rotate(modelMat, personRenderFacing(person), glm::vec3(0.0f, 1.0f, 0.0f));
 
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    modelMat = glm::scale(modelMat, glm::vec3(model.normalizeScale));
+    modelMat = glm::translate(modelMat, model.centerOffset);
+    return modelMat;
 }
 
-void drawRotatedCube(const glm::vec3& pos, const glm::vec3& scaleVec, const glm::vec3& color, float angleY) {
-    glm::mat4 model(1.0f);
-    model = glm::translate(model, pos);
-    model = glm::rotate(model, angleY, glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::scale(model, scaleVec);
+void renderCrosshair() {
+    if (frameSnapshot->state != WAITING) return;
+
+    textureResidency.touch(crosshairTexture);
+
+    DrawItem item;
+    item.program = &overlayShader;
+    item.vao = overlayVAO;
+    item.texture = crosshairTexture;
+    item.primitive = GL_TRIANGLE_FAN;
+    item.count = 4;
+    item.setFloat(UNIFORM_ALPHA, 0.85f);
+    item.setVec2(UNIFORM_OVERLAY_POS, 0.0f, 0.0f);
+    item.setVec2(UNIFORM_OVERLAY_SIZE, 0.05f, 0.05f);
+    renderQueue.submit(PASS_OVERLAY, 0.0f, item);
+}
 
-    glUniformMatrix4fv(glGetUniformLocation(basicShader, "uModel"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3fv(glGetUniformLocation(basicShader, "uColor"), 1, glm::value_ptr(color));
-    glUniform1i(glGetUniformLocation(basicShader, "uUseTexture"), 0);
+void renderStudentOverlay() {
+    if (!studentTexture) return;
 
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    textureResidency.touch(studentTexture);
+
+    DrawItem item;
+    item.program = &overlayShader;
+    item.vao = overlayVAO;
+    item.texture = studentTexture;
+    item.primitive = GL_TRIANGLE_FAN;
+    item.count = 4;
+    item.setVec2(UNIFORM_OVERLAY_POS, 0.78f, -0.78f);
+    item.setVec2(UNIFORM_OVERLAY_SIZE, 0.35f, 0.35f);
+    item.setFloat(UNIFORM_ALPHA, 0.6f);
+    renderQueue.submit(PASS_OVERLAY, 0.0f, item);
 }
 
 bool rayBoxIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDir,
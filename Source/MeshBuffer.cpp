@@ -0,0 +1,223 @@
+#include "../Header/MeshBuffer.h"
+#include "../Header/GLState.h"
+
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+RangeAllocator::RangeAllocator() : capacity(0) {}
+
+void RangeAllocator::reset(uint32_t newCapacity) {
+    freeRanges.clear();
+    capacity = newCapacity;
+    if (capacity > 0) freeRanges[0] = capacity;
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& offset) {
+    if (size == 0) return false;
+    auto best = freeRanges.end();
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->second < size) continue;
+        if (best == freeRanges.end() || it->second < best->second) best = it;
+        if (best->second == size) break;
+    }
+    if (best == freeRanges.end()) return false;
+
+    offset = best->first;
+    uint32_t remaining = best->second - size;
+    freeRanges.erase(best);
+    if (remaining > 0) freeRanges[offset + size] = remaining;
+    return true;
+}
+
+void RangeAllocator::release(uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+    auto next = freeRanges.lower_bound(offset);
+
+    if (next != freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            freeRanges.erase(prev);
+        }
+    }
+    if (next != freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        freeRanges.erase(next);
+    }
+    freeRanges[offset] = size;
+}
+
+void RangeAllocator::grow(uint32_t newCapacity) {
+    if (newCapacity <= capacity) return;
+    uint32_t oldCapacity = capacity;
+    capacity = newCapacity;
+    release(oldCapacity, newCapacity - oldCapacity);
+}
+
+uint32_t RangeAllocator::getFreeTotal() const {
+    uint32_t total = 0;
+    for (const auto& range : freeRanges) total += range.second;
+    return total;
+}
+
+uint32_t RangeAllocator::getLargestFree() const {
+    uint32_t largest = 0;
+    for (const auto& range : freeRanges) {
+        if (range.second > largest) largest = range.second;
+    }
+    return largest;
+}
+
+void indexMeshVertices(const std::vector<float>& triangles, std::vector<float>& vertices,
+                       std::vector<uint32_t>& indices) {
+    const size_t vertexBytes = MESH_VERTEX_FLOATS * sizeof(float);
+    size_t count = triangles.size() / MESH_VERTEX_FLOATS;
+
+    std::unordered_map<std::string, uint32_t> lookup;
+    lookup.reserve(count);
+    vertices.clear();
+    indices.clear();
+    indices.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const float* v = &triangles[i * MESH_VERTEX_FLOATS];
+        std::string key((const char*)v, vertexBytes);
+        auto it = lookup.find(key);
+        if (it != lookup.end()) {
+            indices.push_back(it->second);
+            continue;
+        }
+        uint32_t index = (uint32_t)(vertices.size() / MESH_VERTEX_FLOATS);
+        vertices.insert(vertices.end(), v, v + MESH_VERTEX_FLOATS);
+        lookup.emplace(std::move(key), index);
+        indices.push_back(index);
+    }
+}
+
+MeshBuffer::MeshBuffer() : vao(0), vbo(0), ibo(0) {}
+
+void MeshBuffer::create(uint32_t vertexCapacity, uint32_t indexCapacity) {
+    destroy();
+    vertexRanges.reset(vertexCapacity > 0 ? vertexCapacity : 1);
+    indexRanges.reset(indexCapacity > 0 ? indexCapacity : 1);
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexRanges.getCapacity() * MESH_VERTEX_FLOATS * sizeof(float), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glState.bindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexRanges.getCapacity() * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+    bindVertexAttributes();
+}
+
+void MeshBuffer::destroy() {
+    if (vao) {
+        glState.forgetVertexArray(vao);
+        glDeleteVertexArrays(1, &vao);
+    }
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (ibo) glDeleteBuffers(1, &ibo);
+    vao = vbo = ibo = 0;
+}
+
+void MeshBuffer::bindVertexAttributes() {
+    glState.bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLsizei stride = MESH_VERTEX_FLOATS * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(MESH_MATERIAL_ATTRIB, 4, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
+    glEnableVertexAttribArray(MESH_MATERIAL_ATTRIB);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshBuffer::growVertices(uint32_t minCapacity) {
+    uint32_t oldCapacity = vertexRanges.getCapacity();
+    uint32_t newCapacity = oldCapacity;
+    while (newCapacity < minCapacity) newCapacity *= 2;
+
+    GLuint newVbo;
+    glGenBuffers(1, &newVbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newCapacity * MESH_VERTEX_FLOATS * sizeof(float), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        (GLsizeiptr)oldCapacity * MESH_VERTEX_FLOATS * sizeof(float));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &vbo);
+    vbo = newVbo;
+    vertexRanges.grow(newCapacity);
+    bindVertexAttributes();
+}
+
+void MeshBuffer::growIndices(uint32_t minCapacity) {
+    uint32_t oldCapacity = indexRanges.getCapacity();
+    uint32_t newCapacity = oldCapacity;
+    while (newCapacity < minCapacity) newCapacity *= 2;
+
+    GLuint newIbo;
+    glGenBuffers(1, &newIbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newIbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newCapacity * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, ibo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldCapacity * sizeof(uint32_t));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &ibo);
+    ibo = newIbo;
+    indexRanges.grow(newCapacity);
+    glState.bindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+}
+
+bool MeshBuffer::add(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                     MeshAllocation& allocation) {
+    if (!vao || vertexCount == 0 || indexCount == 0) return false;
+
+    uint32_t vertexOffset, indexOffset;
+    if (!vertexRanges.allocate(vertexCount, vertexOffset)) {
+        growVertices(vertexRanges.getCapacity() + vertexCount);
+        if (!vertexRanges.allocate(vertexCount, vertexOffset)) return false;
+    }
+    if (!indexRanges.allocate(indexCount, indexOffset)) {
+        growIndices(indexRanges.getCapacity() + indexCount);
+        if (!indexRanges.allocate(indexCount, indexOffset)) {
+            vertexRanges.release(vertexOffset, vertexCount);
+            return false;
+        }
+    }
+
+    // The copy targets leave the VAO's element buffer binding alone.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)vertexOffset * MESH_VERTEX_FLOATS * sizeof(float),
+                    (GLsizeiptr)vertexCount * MESH_VERTEX_FLOATS * sizeof(float), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)indexOffset * sizeof(uint32_t),
+                    (GLsizeiptr)indexCount * sizeof(uint32_t), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    allocation.baseVertex = (GLint)vertexOffset;
+    allocation.firstIndex = indexOffset;
+    allocation.indexCount = (GLsizei)indexCount;
+    allocation.vertexCount = (GLsizei)vertexCount;
+    return true;
+}
+
+void MeshBuffer::remove(const MeshAllocation& allocation) {
+    vertexRanges.release((uint32_t)allocation.baseVertex, (uint32_t)allocation.vertexCount);
+    indexRanges.release(allocation.firstIndex, (uint32_t)allocation.indexCount);
+}
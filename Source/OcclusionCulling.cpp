@@ -0,0 +1,241 @@
+#include "../Header/OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+static float edgeA(const glm::vec3& a, const glm::vec3& b) { return a.y - b.y; }
+static float edgeB(const glm::vec3& a, const glm::vec3& b) { return b.x - a.x; }
+static float edgeC(const glm::vec3& a, const glm::vec3& b) { return a.x * b.y - a.y * b.x; }
+
+static glm::vec3 toScreen(const glm::vec4& clip) {
+    float invW = 1.0f / clip.w;
+    return glm::vec3((clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH,
+                     (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+                     clip.z * invW);
+}
+
+// Clips a triangle against the near plane (z + w >= 0); returns 0, 3 or 4 vertices.
+static int clipNear(const glm::vec4* in, glm::vec4* out) {
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& p = in[i];
+        const glm::vec4& q = in[(i + 1) % 3];
+        float dp = p.z + p.w;
+        float dq = q.z + q.w;
+        if (dp >= 0.0f) out[count++] = p;
+        if ((dp >= 0.0f) != (dq >= 0.0f)) {
+            float t = dp / (dp - dq);
+            out[count++] = p + (q - p) * t;
+        }
+    }
+    return count;
+}
+
+OcclusionCuller::OcclusionCuller()
+    : depth((size_t)OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), viewProjection(1.0f),
+      jobPending(false), jobRunning(false), quit(false), frameValid(false) {}
+
+OcclusionCuller::~OcclusionCuller() {
+    shutdown();
+}
+
+void OcclusionCuller::setOccluders(const std::vector<glm::vec3>& triangles) {
+    occluders = triangles;
+}
+
+void OcclusionCuller::start() {
+    if (worker.joinable()) return;
+    quit = false;
+    worker = std::thread(&OcclusionCuller::workerLoop, this);
+}
+
+void OcclusionCuller::shutdown() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& matrix) {
+    if (!worker.joinable()) {
+        viewProjection = matrix;
+        rasterize();
+        frameValid = true;
+        return;
+    }
+    // The worker reads the matrix and writes the buffer without holding the lock.
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        viewProjection = matrix;
+        frameValid = false;
+        jobPending = true;
+    }
+    wake.notify_one();
+}
+
+void OcclusionCuller::finish() {
+    if (!worker.joinable()) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !jobPending && !jobRunning; });
+}
+
+void OcclusionCuller::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return jobPending || quit; });
+        if (quit) return;
+        jobPending = false;
+        jobRunning = true;
+        lock.unlock();
+
+        rasterize();
+
+        lock.lock();
+        jobRunning = false;
+        frameValid = true;
+        done.notify_all();
+    }
+}
+
+void OcclusionCuller::rasterize() {
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    for (size_t i = 0; i + 2 < occluders.size(); i += 3) {
+        glm::vec4 clip[3];
+        for (int v = 0; v < 3; v++) clip[v] = viewProjection * glm::vec4(occluders[i + v], 1.0f);
+
+        glm::vec4 clipped[4];
+        int count = clipNear(clip, clipped);
+        for (int v = 1; v + 1 < count; v++) {
+            rasterizeTriangle(clipped[0], clipped[v], clipped[v + 1]);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTriangle(const glm::vec4& ca, const glm::vec4& cb, const glm::vec4& cc) {
+    glm::vec3 v0 = toScreen(ca);
+    glm::vec3 v1 = toScreen(cb);
+    glm::vec3 v2 = toScreen(cc);
+
+    float area = edgeA(v0, v1) * v2.x + edgeB(v0, v1) * v2.y + edgeC(v0, v1);
+    if (fabsf(area) < 1e-6f) return;
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    int minX = std::max(0, (int)floorf(std::min(v0.x, std::min(v1.x, v2.x))));
+    int maxX = std::min(OCCLUSION_WIDTH - 1, (int)ceilf(std::max(v0.x, std::max(v1.x, v2.x))));
+    int minY = std::max(0, (int)floorf(std::min(v0.y, std::min(v1.y, v2.y))));
+    int maxY = std::min(OCCLUSION_HEIGHT - 1, (int)ceilf(std::max(v0.y, std::max(v1.y, v2.y))));
+    if (minX > maxX || minY > maxY) return;
+    minX &= ~3;
+
+    // Edge functions and depth are linear in screen space: value = A*x + B*y + C.
+    float a0 = edgeA(v1, v2), b0 = edgeB(v1, v2), c0 = edgeC(v1, v2);
+    float a1 = edgeA(v2, v0), b1 = edgeB(v2, v0), c1 = edgeC(v2, v0);
+    float a2 = edgeA(v0, v1), b2 = edgeB(v0, v1), c2 = edgeC(v0, v1);
+    float invArea = 1.0f / area;
+    float za = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+    float zb = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * invArea;
+    float zc = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * invArea;
+
+#ifdef OCCLUSION_USE_SSE
+    __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 a0v = _mm_set1_ps(a0), a1v = _mm_set1_ps(a1), a2v = _mm_set1_ps(a2), zav = _mm_set1_ps(za);
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = (float)y + 0.5f;
+        __m128 row0 = _mm_set1_ps(b0 * py + c0);
+        __m128 row1 = _mm_set1_ps(b1 * py + c1);
+        __m128 row2 = _mm_set1_ps(b2 * py + c2);
+        __m128 rowZ = _mm_set1_ps(zb * py + zc);
+        float* line = &depth[(size_t)y * OCCLUSION_WIDTH];
+
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0v, px), row0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1v, px), row1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2v, px), row2);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                            _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+            if (!_mm_movemask_ps(inside)) continue;
+
+            __m128 z = _mm_add_ps(_mm_mul_ps(zav, px), rowZ);
+            __m128 old = _mm_loadu_ps(line + x);
+            __m128 write = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+            _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(write, z), _mm_andnot_ps(write, old)));
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; y++) {
+        float py = (float)y + 0.5f;
+        float* line = &depth[(size_t)y * OCCLUSION_WIDTH];
+        for (int x = minX; x <= maxX; x++) {
+            float px = (float)x + 0.5f;
+            if (a0 * px + b0 * py + c0 < 0.0f) continue;
+            if (a1 * px + b1 * py + c1 < 0.0f) continue;
+            if (a2 * px + b2 * py + c2 < 0.0f) continue;
+            float z = za * px + zb * py + zc;
+            if (z < line[x]) line[x] = z;
+        }
+    }
+#endif
+}
+
+bool OcclusionCuller::isOccluded(const AABB& box) const {
+    if (!frameValid) return false;
+
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        // A box reaching past the near plane covers the camera; never cull it.
+        if (clip.z + clip.w < 0.0f) return false;
+        glm::vec3 screen = toScreen(clip);
+        minX = std::min(minX, screen.x);
+        maxX = std::max(maxX, screen.x);
+        minY = std::min(minY, screen.y);
+        maxY = std::max(maxY, screen.y);
+        nearest = std::min(nearest, screen.z);
+    }
+
+    int x0 = std::max(0, (int)floorf(minX));
+    int x1 = std::min(OCCLUSION_WIDTH - 1, (int)floorf(maxX));
+    int y0 = std::max(0, (int)floorf(minY));
+    int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)floorf(maxY));
+    if (x0 > x1 || y0 > y1) return false;
+    // Widening to whole 4-pixel groups only tests extra pixels, which can
+    // make the box visible but never hides it wrongly.
+    x0 &= ~3;
+
+#ifdef OCCLUSION_USE_SSE
+    __m128 boxDepth = _mm_set1_ps(nearest);
+    for (int y = y0; y <= y1; y++) {
+        const float* line = &depth[(size_t)y * OCCLUSION_WIDTH];
+        for (int x = x0; x <= x1; x += 4) {
+            if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(line + x), boxDepth))) return false;
+        }
+    }
+#else
+    for (int y = y0; y <= y1; y++) {
+        const float* line = &depth[(size_t)y * OCCLUSION_WIDTH];
+        for (int x = x0; x <= x1; x++) {
+            if (line[x] >= nearest) return false;
+        }
+    }
+#endif
+    return true;
+}
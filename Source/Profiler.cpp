@@ -0,0 +1,170 @@
+#include "../Header/Profiler.h"
+
+#include <GL/glew.h>
+#include <iostream>
+#include <iomanip>
+
+struct ProfilerCounterInfo {
+    const char* name;
+    ProfilerCounterKind kind;
+    ProfilerUnit unit;
+};
+
+static const ProfilerCounterInfo counterInfo[PROF_COUNTER_COUNT] = {
+    { "texture budget",          PROF_KIND_GAUGE,     PROF_UNIT_BYTES },
+    { "texture resident",        PROF_KIND_GAUGE,     PROF_UNIT_BYTES },
+    { "texture evictions",       PROF_KIND_TOTAL,     PROF_UNIT_COUNT },
+    { "texture restreams",       PROF_KIND_TOTAL,     PROF_UNIT_COUNT },
+    { "gpu frame time",          PROF_KIND_PER_FRAME, PROF_UNIT_MICROSECONDS },
+    { "draw calls",              PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "uniform gl calls",        PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "uniform lookups",         PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "instance uploads",        PROF_KIND_PER_FRAME, PROF_UNIT_BYTES },
+    { "queued draw items",       PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "state changes",           PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "elided gl calls",         PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "gl state mismatches",     PROF_KIND_TOTAL,     PROF_UNIT_COUNT },
+    { "objects visible",         PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "objects culled",          PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "objects occluded",        PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "indirect commands",       PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "clustered lights",        PROF_KIND_GAUGE,     PROF_UNIT_COUNT },
+    { "cluster light refs",      PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "shadow cache rebuilds",   PROF_KIND_TOTAL,     PROF_UNIT_COUNT },
+    { "shadow casters drawn",    PROF_KIND_PER_FRAME, PROF_UNIT_COUNT },
+    { "ring buffer writes",      PROF_KIND_PER_FRAME, PROF_UNIT_BYTES },
+    { "ring buffer fence waits", PROF_KIND_TOTAL,     PROF_UNIT_COUNT },
+    { "render scale %",          PROF_KIND_GAUGE,     PROF_UNIT_COUNT },
+};
+
+const double REPORT_INTERVAL = 2.0;
+const int GPU_QUERY_COUNT = 4;
+
+long long profilerCounters[PROF_COUNTER_COUNT] = {};
+
+static long long frameSums[PROF_COUNTER_COUNT] = {};
+static long long lastFrameValues[PROF_COUNTER_COUNT] = {};
+static int framesSinceReport = 0;
+static double lastReportTime = -1.0;
+static bool reporting = false;
+
+static GLuint gpuQueries[GPU_QUERY_COUNT] = {};
+static bool gpuQueryPending[GPU_QUERY_COUNT] = {};
+static int gpuQueryIndex = 0;
+static bool gpuQueryActive = false;
+static double gpuDrainMs = 0.0;
+static int gpuDrainFrames = 0;
+static double gpuLastMs = 0.0;
+static long long gpuSamples = 0;
+
+static void printCounter(const ProfilerCounterInfo& info, double value) {
+    std::cout << "  " << std::left << std::setw(28) << info.name << std::right;
+    if (info.unit == PROF_UNIT_BYTES) {
+        std::cout << std::fixed << std::setprecision(2) << value / (1024.0 * 1024.0) << " MB";
+    } else if (info.unit == PROF_UNIT_MICROSECONDS) {
+        std::cout << std::fixed << std::setprecision(3) << value / 1000.0 << " ms";
+    } else {
+        std::cout << std::fixed << std::setprecision(info.kind == PROF_KIND_PER_FRAME ? 1 : 0) << value;
+    }
+    std::cout << std::endl;
+}
+
+static void printReport(double elapsed) {
+    double frames = framesSinceReport > 0 ? (double)framesSinceReport : 1.0;
+    std::cout << "---- Profiler (" << framesSinceReport << " frames, "
+              << std::fixed << std::setprecision(1) << frames / elapsed << " fps) ----" << std::endl;
+    for (int i = 0; i < PROF_COUNTER_COUNT; i++) {
+        double value = counterInfo[i].kind == PROF_KIND_PER_FRAME
+            ? (double)frameSums[i] / frames
+            : (double)profilerCounters[i];
+        printCounter(counterInfo[i], value);
+    }
+}
+
+void profilerEndFrame(double now) {
+    for (int i = 0; i < PROF_COUNTER_COUNT; i++) {
+        if (counterInfo[i].kind == PROF_KIND_PER_FRAME) {
+            frameSums[i] += profilerCounters[i];
+            lastFrameValues[i] = profilerCounters[i];
+            profilerCounters[i] = 0;
+        }
+    }
+    framesSinceReport++;
+
+    if (lastReportTime < 0.0) lastReportTime = now;
+    double elapsed = now - lastReportTime;
+    if (elapsed < REPORT_INTERVAL) return;
+
+    if (reporting) printReport(elapsed);
+
+    for (int i = 0; i < PROF_COUNTER_COUNT; i++) frameSums[i] = 0;
+    framesSinceReport = 0;
+    lastReportTime = now;
+}
+
+long long profilerLastFrame(ProfilerCounter counter) {
+    return lastFrameValues[counter];
+}
+
+void profilerSetReporting(bool enabled) {
+    reporting = enabled;
+}
+
+bool profilerIsReporting() {
+    return reporting;
+}
+
+static void resolveGpuQuery(int index, bool wait) {
+    if (!gpuQueryPending[index]) return;
+    GLint available = 0;
+    if (!wait) {
+        glGetQueryObjectiv(gpuQueries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+    }
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(gpuQueries[index], GL_QUERY_RESULT, &ns);
+    gpuQueryPending[index] = false;
+    profilerAdd(PROF_GPU_FRAME_US, (long long)(ns / 1000));
+    gpuDrainMs += (double)ns / 1.0e6;
+    gpuDrainFrames++;
+    gpuLastMs = (double)ns / 1.0e6;
+    gpuSamples++;
+}
+
+void profilerGpuInit() {
+    glGenQueries(GPU_QUERY_COUNT, gpuQueries);
+}
+
+void profilerGpuShutdown() {
+    glDeleteQueries(GPU_QUERY_COUNT, gpuQueries);
+}
+
+void profilerGpuBeginFrame() {
+    if (!gpuQueries[0]) return;
+    for (int i = 0; i < GPU_QUERY_COUNT; i++) resolveGpuQuery(i, false);
+    if (gpuQueryPending[gpuQueryIndex]) return;
+    glBeginQuery(GL_TIME_ELAPSED, gpuQueries[gpuQueryIndex]);
+    gpuQueryActive = true;
+}
+
+void profilerGpuEndFrame() {
+    if (!gpuQueryActive) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuQueryPending[gpuQueryIndex] = true;
+    gpuQueryIndex = (gpuQueryIndex + 1) % GPU_QUERY_COUNT;
+    gpuQueryActive = false;
+}
+
+double profilerGpuLastFrameMs(long long& sampleIndex) {
+    sampleIndex = gpuSamples;
+    return gpuLastMs;
+}
+
+double profilerGpuDrain(int& frames) {
+    for (int i = 0; i < GPU_QUERY_COUNT; i++) resolveGpuQuery(i, true);
+    double ms = gpuDrainMs;
+    frames = gpuDrainFrames;
+    gpuDrainMs = 0.0;
+    gpuDrainFrames = 0;
+    return ms;
+}
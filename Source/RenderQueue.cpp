@@ -0,0 +1,300 @@
+#include "../Header/RenderQueue.h"
+#include "../Header/Profiler.h"
+#include "../Header/GLState.h"
+
+// Sort key layout, most significant first.
+const int KEY_PASS_SHIFT = 60;
+const int KEY_PROGRAM_SHIFT = 50;
+const int KEY_VAO_SHIFT = 38;
+const int KEY_TEXTURE_SHIFT = 24;
+const uint32_t KEY_PROGRAM_MAX = (1u << 10) - 1;
+const uint32_t KEY_VAO_MAX = (1u << 12) - 1;
+const uint32_t KEY_TEXTURE_MAX = (1u << 14) - 1;
+const uint32_t KEY_DEPTH_MAX = (1u << 24) - 1;
+const float KEY_DEPTH_RANGE = 100.0f;
+// Smallest share of keys worth handing to another thread.
+const int KEY_JOB_CHUNK = 1024;
+
+DrawItem::DrawItem()
+    : program(nullptr), vao(0), texture(0), textureUnit(0), textureTarget(GL_TEXTURE_2D), primitive(GL_TRIANGLES), first(0), count(0),
+      instances(0), baseVertex(0), baseInstance(0), instanceBuffer(0), flags(0), model(1.0f),
+      uniformCount(0) {}
+
+void DrawItem::setModel(const glm::mat4& matrix) {
+    model = matrix;
+    normalMatrix = ::normalMatrix(matrix);
+    flags |= DRAW_MODEL_MATRIX;
+}
+
+void DrawItem::setInt(ShaderUniform uniform, int value) {
+    if (uniformCount >= MAX_DRAW_UNIFORMS) return;
+    DrawUniform& u = uniforms[uniformCount++];
+    u.uniform = uniform;
+    u.components = 0;
+    u.intValue = value;
+}
+
+void DrawItem::setFloat(ShaderUniform uniform, float value) {
+    if (uniformCount >= MAX_DRAW_UNIFORMS) return;
+    DrawUniform& u = uniforms[uniformCount++];
+    u.uniform = uniform;
+    u.components = 1;
+    u.value[0] = value;
+}
+
+void DrawItem::setVec2(ShaderUniform uniform, float x, float y) {
+    if (uniformCount >= MAX_DRAW_UNIFORMS) return;
+    DrawUniform& u = uniforms[uniformCount++];
+    u.uniform = uniform;
+    u.components = 2;
+    u.value[0] = x;
+    u.value[1] = y;
+}
+
+void DrawItem::setVec3(ShaderUniform uniform, const glm::vec3& value) {
+    if (uniformCount >= MAX_DRAW_UNIFORMS) return;
+    DrawUniform& u = uniforms[uniformCount++];
+    u.uniform = uniform;
+    u.components = 3;
+    u.value[0] = value.x;
+    u.value[1] = value.y;
+    u.value[2] = value.z;
+}
+
+RenderQueue::RenderQueue()
+    : indirectBuffer(0), boundInstanceBuffer(0), boundInstanceVao(0), boundBaseInstance(0),
+      overlaySequence(0) {}
+
+void RenderQueue::destroy() {
+    if (indirectBuffer) glDeleteBuffers(1, &indirectBuffer);
+    indirectBuffer = 0;
+}
+
+void RenderQueue::clear() {
+    items.clear();
+    stateKeys.clear();
+    depths.clear();
+    overlaySequence = 0;
+}
+
+uint32_t RenderQueue::denseId(std::unordered_map<GLuint, uint32_t>& ids, GLuint name, uint32_t maxId) {
+    if (name == 0) return 0;
+    auto it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    uint32_t id = (uint32_t)ids.size() + 1;
+    if (id > maxId) id = maxId;
+    ids[name] = id;
+    return id;
+}
+
+// Everything but the depth bits. Overlays keep submission order through a
+// sequence number in the depth bits instead.
+uint64_t RenderQueue::makeStateKey(RenderPass pass, const DrawItem& item) {
+    uint64_t key = (uint64_t)pass << KEY_PASS_SHIFT;
+
+    if (pass == PASS_OVERLAY) {
+        return key | (overlaySequence++ & KEY_DEPTH_MAX);
+    }
+
+    uint32_t programId = denseId(programIds, item.program ? item.program->id() : 0, KEY_PROGRAM_MAX);
+    uint32_t vaoId = denseId(vaoIds, item.vao, KEY_VAO_MAX);
+    uint32_t textureId = denseId(textureIds, item.texture, KEY_TEXTURE_MAX);
+
+    key |= (uint64_t)programId << KEY_PROGRAM_SHIFT;
+    key |= (uint64_t)vaoId << KEY_VAO_SHIFT;
+    key |= (uint64_t)textureId << KEY_TEXTURE_SHIFT;
+    return key;
+}
+
+void RenderQueue::submit(RenderPass pass, float depth, const DrawItem& item) {
+    stateKeys.push_back(makeStateKey(pass, item));
+    depths.push_back(pass == PASS_OVERLAY ? 0.0f : depth);
+    items.push_back(item);
+}
+
+void RenderQueue::buildKeys(JobSystem& jobs) {
+    keys.resize(items.size());
+    jobs.parallelFor((int)items.size(), KEY_JOB_CHUNK, [this](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            float normalized = depths[i] / KEY_DEPTH_RANGE;
+            if (normalized < 0.0f) normalized = 0.0f;
+            if (normalized > 1.0f) normalized = 1.0f;
+            keys[i] = stateKeys[i] | (uint32_t)(normalized * (float)KEY_DEPTH_MAX);
+        }
+    });
+}
+
+void RenderQueue::radixSort() {
+    size_t n = keys.size();
+    order.resize(n);
+    for (size_t i = 0; i < n; i++) order[i] = (uint32_t)i;
+    scratchKeys.resize(n);
+    scratchOrder.resize(n);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {};
+        for (size_t i = 0; i < n; i++) counts[(keys[i] >> shift) & 0xFF]++;
+
+        // Skip digits that are the same for every key, which is most of them.
+        if (counts[(keys[0] >> shift) & 0xFF] == n) continue;
+
+        size_t offsets[256];
+        size_t sum = 0;
+        for (int b = 0; b < 256; b++) {
+            offsets[b] = sum;
+            sum += counts[b];
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t dst = offsets[(keys[i] >> shift) & 0xFF]++;
+            scratchKeys[dst] = keys[i];
+            scratchOrder[dst] = order[i];
+        }
+        keys.swap(scratchKeys);
+        order.swap(scratchOrder);
+    }
+}
+
+void RenderQueue::applyUniforms(const DrawItem& item) const {
+    const ShaderProgram* program = item.program;
+    if (item.flags & DRAW_MODEL_MATRIX) {
+        program->setMat4(UNIFORM_MODEL, item.model);
+        program->setMat3(UNIFORM_NORMAL_MATRIX, item.normalMatrix);
+    }
+
+    for (int i = 0; i < item.uniformCount; i++) {
+        const DrawUniform& u = item.uniforms[i];
+        switch (u.components) {
+            case 0: program->setInt(u.uniform, u.intValue); break;
+            case 1: program->setFloat(u.uniform, u.value[0]); break;
+            case 2: program->setVec2(u.uniform, u.value[0], u.value[1]); break;
+            default: program->setVec3(u.uniform, glm::vec3(u.value[0], u.value[1], u.value[2])); break;
+        }
+    }
+}
+
+// Items can share one indirect multi-draw when they bind the same program,
+// VAO and texture. Only indexed items whose uniforms are all shared state
+// qualify: anything per draw (a model matrix, a tint) would be lost after the
+// first command.
+static bool canMerge(const DrawItem& a, const DrawItem& b) {
+    if (!(a.flags & DRAW_INDEXED) || (a.flags & DRAW_MODEL_MATRIX) || a.uniformCount > 0) return false;
+    if (a.flags != b.flags || b.uniformCount > 0 || b.count <= 0) return false;
+    if (a.primitive != b.primitive || a.instanceBuffer != b.instanceBuffer) return false;
+    return a.program == b.program && a.vao == b.vao && a.texture == b.texture;
+}
+
+void RenderQueue::attachInstances(const DrawItem& item) {
+    if (!item.instanceBuffer) return;
+    if (item.instanceBuffer == boundInstanceBuffer && item.vao == boundInstanceVao &&
+        item.baseInstance == boundBaseInstance) return;
+    attachInstanceAttributes(item.vao, item.instanceBuffer, item.baseInstance);
+    boundInstanceBuffer = item.instanceBuffer;
+    boundInstanceVao = item.vao;
+    boundBaseInstance = item.baseInstance;
+    profilerAdd(PROF_STATE_CHANGES);
+}
+
+void RenderQueue::drawItem(const DrawItem& item, bool baseInstanceDraws) {
+    if (item.instances > 0 && !baseInstanceDraws) attachInstances(item);
+
+    if (!(item.flags & DRAW_INDEXED)) {
+        if (item.instances <= 0) {
+            glDrawArrays(item.primitive, item.first, item.count);
+        } else if (baseInstanceDraws) {
+            glDrawArraysInstancedBaseInstance(item.primitive, item.first, item.count, item.instances, item.baseInstance);
+        } else {
+            glDrawArraysInstanced(item.primitive, item.first, item.count, item.instances);
+        }
+        return;
+    }
+
+    const void* indexOffset = (const void*)((size_t)item.first * sizeof(GLuint));
+    if (item.instances <= 0) {
+        glDrawElementsBaseVertex(item.primitive, item.count, GL_UNSIGNED_INT, indexOffset, item.baseVertex);
+    } else if (baseInstanceDraws) {
+        glDrawElementsInstancedBaseVertexBaseInstance(item.primitive, item.count, GL_UNSIGNED_INT, indexOffset,
+                                                      item.instances, item.baseVertex, item.baseInstance);
+    } else {
+        glDrawElementsInstancedBaseVertex(item.primitive, item.count, GL_UNSIGNED_INT, indexOffset,
+                                          item.instances, item.baseVertex);
+    }
+}
+
+void RenderQueue::execute(JobSystem& jobs) {
+    if (items.empty()) return;
+    buildKeys(jobs);
+    radixSort();
+
+    bool baseInstanceDraws = GLEW_ARB_base_instance != 0;
+    bool multiDraw = baseInstanceDraws && GLEW_ARB_multi_draw_indirect;
+
+    runs.clear();
+    commands.clear();
+    for (uint32_t i = 0; i < (uint32_t)order.size();) {
+        const DrawItem& item = items[order[i]];
+        if (!item.program || item.count <= 0) {
+            i++;
+            continue;
+        }
+
+        uint32_t end = i + 1;
+        if (multiDraw) {
+            while (end < order.size() && canMerge(item, items[order[end]])) end++;
+        }
+
+        DrawRun run = { i, end - i, -1 };
+        if (run.count > 1) {
+            run.command = (int)commands.size();
+            for (uint32_t k = i; k < end; k++) {
+                const DrawItem& merged = items[order[k]];
+                DrawElementsIndirectCommand command;
+                command.count = (GLuint)merged.count;
+                command.instanceCount = merged.instances > 0 ? (GLuint)merged.instances : 1;
+                command.firstIndex = (GLuint)merged.first;
+                command.baseVertex = merged.baseVertex;
+                command.baseInstance = merged.baseInstance;
+                commands.push_back(command);
+            }
+        }
+        runs.push_back(run);
+        i = end;
+    }
+
+    if (!commands.empty()) {
+        if (!indirectBuffer) glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand),
+                     commands.data(), GL_STREAM_DRAW);
+        profilerAdd(PROF_INDIRECT_COMMANDS, (long long)commands.size());
+    }
+
+    boundInstanceBuffer = 0;
+    boundInstanceVao = 0;
+    boundBaseInstance = 0;
+
+    for (const DrawRun& run : runs) {
+        const DrawItem& item = items[order[run.start]];
+
+        // Consecutive items mostly share state thanks to the sort; the cache
+        // drops whatever is already bound.
+        glState.setEnabled(GL_CULL_FACE, (item.flags & DRAW_CULL_FACE) != 0);
+        glState.setEnabled(GL_DEPTH_TEST, (item.flags & DRAW_DEPTH_TEST) != 0);
+        item.program->use();
+        glState.bindVertexArray(item.vao);
+        if (item.texture) glState.bindTexture(item.textureUnit, item.texture, item.textureTarget);
+
+        applyUniforms(item);
+
+        if (run.command >= 0) {
+            glMultiDrawElementsIndirect(item.primitive, GL_UNSIGNED_INT,
+                                        (const void*)(run.command * sizeof(DrawElementsIndirectCommand)),
+                                        (GLsizei)run.count, 0);
+        } else {
+            drawItem(item, baseInstanceDraws);
+        }
+        profilerAdd(PROF_DRAW_CALLS);
+    }
+
+    if (!commands.empty()) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    profilerAdd(PROF_QUEUED_ITEMS, (long long)items.size());
+}
@@ -0,0 +1,150 @@
+#include "../Header/ShaderProgram.h"
+#include "../Header/Util.h"
+#include "../Header/Profiler.h"
+#include "../Header/GLState.h"
+
+static const char* uniformNames[UNIFORM_COUNT] = {
+    "uModel",
+    "uNormalMatrix",
+    "uColor",
+    "uAlpha",
+    "uTexture",
+    "uMaterialTextures",
+    "uClusterOffsets",
+    "uClusterIndices",
+    "uClusterLights",
+    "uShadowMap",
+    "uLightSpace",
+    "uBakedRoomLight",
+    "uBakedProjectorLight",
+    "uUseLighting",
+    "uUseTexture",
+    "uEmissionColor",
+    "uEmissionStrength",
+    "uPos",
+    "uSize",
+};
+
+static bool lookupByName = false;
+
+ShaderProgram::ShaderProgram() : program(0) {
+    for (int i = 0; i < UNIFORM_COUNT; i++) locations[i] = -1;
+}
+
+bool ShaderProgram::create(const char* vsPath, const char* fsPath, const std::string& defines) {
+    destroy();
+    program = createShaderVariant(vsPath, fsPath, defines);
+    if (!program) return false;
+    reflect();
+    return true;
+}
+
+void ShaderProgram::destroy() {
+    if (program) glDeleteProgram(program);
+    program = 0;
+    uniforms.clear();
+    for (int i = 0; i < UNIFORM_COUNT; i++) locations[i] = -1;
+}
+
+void ShaderProgram::reflect() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName(name.c_str(), length);
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            uniformName.resize(uniformName.size() - 3);
+        }
+
+        // Block members report a location of -1 and are left out of the table.
+        GLint loc = glGetUniformLocation(program, uniformName.c_str());
+        if (loc >= 0) uniforms[uniformName] = loc;
+    }
+
+    for (int i = 0; i < UNIFORM_COUNT; i++) {
+        auto it = uniforms.find(uniformNames[i]);
+        locations[i] = it != uniforms.end() ? it->second : -1;
+    }
+
+    GLuint blockIndex = glGetUniformBlockIndex(program, "FrameData");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, blockIndex, FRAME_DATA_BINDING);
+    }
+    blockIndex = glGetUniformBlockIndex(program, "ClusterData");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, blockIndex, CLUSTER_DATA_BINDING);
+    }
+}
+
+GLint ShaderProgram::location(const std::string& name) const {
+    auto it = uniforms.find(name);
+    return it != uniforms.end() ? it->second : -1;
+}
+
+void ShaderProgram::setLookupByName(bool enabled) {
+    lookupByName = enabled;
+}
+
+GLint ShaderProgram::resolve(ShaderUniform uniform) const {
+    if (!lookupByName) return locations[uniform];
+    profilerAdd(PROF_UNIFORM_LOOKUPS);
+    return glGetUniformLocation(program, uniformNames[uniform]);
+}
+
+void ShaderProgram::use() const {
+    glState.useProgram(program);
+}
+
+void ShaderProgram::setInt(ShaderUniform uniform, int value) const {
+    GLint loc = resolve(uniform);
+    if (loc < 0) return;
+    glUniform1i(loc, value);
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
+
+void ShaderProgram::setFloat(ShaderUniform uniform, float value) const {
+    GLint loc = resolve(uniform);
+    if (loc < 0) return;
+    glUniform1f(loc, value);
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
+
+void ShaderProgram::setVec2(ShaderUniform uniform, float x, float y) const {
+    GLint loc = resolve(uniform);
+    if (loc < 0) return;
+    glUniform2f(loc, x, y);
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
+
+void ShaderProgram::setVec3(ShaderUniform uniform, const glm::vec3& value) const {
+    GLint loc = resolve(uniform);
+    if (loc < 0) return;
+    glUniform3fv(loc, 1, glm::value_ptr(value));
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
+
+void ShaderProgram::setMat3(ShaderUniform uniform, const glm::mat3& value) const {
+    GLint loc = resolve(uniform);
+    if (loc < 0) return;
+    glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(value));
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
+
+void ShaderProgram::setMat4(ShaderUniform uniform, const glm::mat4& value) const {
+    GLint loc = resolve(uniform);
+    if (loc < 0) return;
+    glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(value));
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
+
+void frameDataBind(GLuint buffer, GLintptr offset) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, buffer, offset, sizeof(FrameData));
+    profilerAdd(PROF_GL_UNIFORM_CALLS);
+}
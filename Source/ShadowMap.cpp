@@ -0,0 +1,90 @@
+#include "../Header/ShadowMap.h"
+#include "../Header/GLState.h"
+#include "../Header/Profiler.h"
+
+#include <iostream>
+
+ShadowMapCache::ShadowMapCache()
+    : staticDepth(0), dynamicDepth(0), staticFbo(0), dynamicFbo(0), size(0), lightSpace(1.0f),
+      staticKey(0), staticValid(false), dynamicUsed(false) {}
+
+GLuint ShadowMapCache::createDepthTexture() {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glState.bindTexture(SHADOW_MAP_UNIT, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Hardware depth compare, read through sampler2DShadow.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    return texture;
+}
+
+void ShadowMapCache::create(int mapSize) {
+    destroy();
+    size = mapSize;
+    staticDepth = createDepthTexture();
+    dynamicDepth = createDepthTexture();
+
+    GLuint* fbos[2] = { &staticFbo, &dynamicFbo };
+    GLuint textures[2] = { staticDepth, dynamicDepth };
+    for (int i = 0; i < 2; i++) {
+        glGenFramebuffers(1, fbos[i]);
+        glBindFramebuffer(GL_FRAMEBUFFER, *fbos[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textures[i], 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Shadow map framebuffer incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    staticValid = false;
+}
+
+void ShadowMapCache::destroy() {
+    if (staticFbo) glDeleteFramebuffers(1, &staticFbo);
+    if (dynamicFbo) glDeleteFramebuffers(1, &dynamicFbo);
+    GLuint textures[2] = { staticDepth, dynamicDepth };
+    for (GLuint texture : textures) {
+        if (!texture) continue;
+        glState.forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+    staticFbo = dynamicFbo = staticDepth = dynamicDepth = 0;
+    staticValid = false;
+}
+
+void ShadowMapCache::beginFrame(const glm::mat4& matrix) {
+    lightSpace = matrix;
+    dynamicUsed = false;
+}
+
+bool ShadowMapCache::needsStaticUpdate(unsigned long long key) const {
+    return !staticValid || key != staticKey;
+}
+
+void ShadowMapCache::beginStatic(unsigned long long key) {
+    glBindFramebuffer(GL_FRAMEBUFFER, staticFbo);
+    glViewport(0, 0, size, size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    staticKey = key;
+    staticValid = true;
+    profilerAdd(PROF_SHADOW_STATIC_UPDATES);
+}
+
+void ShadowMapCache::beginDynamic() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dynamicFbo);
+    glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, dynamicFbo);
+    glViewport(0, 0, size, size);
+    dynamicUsed = true;
+}
+
+void ShadowMapCache::end() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,275 @@
+#include "../Header/TextureImport.h"
+#include "../Header/Util.h"
+#include "../Header/stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTURE_IMPORT_SSE2 1
+#endif
+
+namespace fs = std::filesystem;
+
+const char* const TEXTURE_CACHE_DIR = "Cache/textures";
+const uint32_t TEXTURE_CACHE_MAGIC = 0x31435854; // "TXC1"
+const int LANCZOS_RADIUS = 3;
+
+struct TextureCacheHeader {
+    uint32_t magic;
+    int32_t sourceWidth, sourceHeight;
+    int32_t width, height, channels;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+size_t textureMipChainBytes(int width, int height, int channels) {
+    size_t total = 0;
+    int bpp = channels == 3 ? 4 : channels;
+    while (true) {
+        total += (size_t)width * (size_t)height * (size_t)bpp;
+        if (width == 1 && height == 1) break;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return total;
+}
+
+void imageAverageColor(const unsigned char* pixels, int width, int height, int channels, float rgb[3]) {
+    uint64_t sums[3] = { 0, 0, 0 };
+    size_t count = (size_t)width * (size_t)height;
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* texel = pixels + i * channels;
+        for (int c = 0; c < 3; c++) sums[c] += texel[channels >= 3 ? c : 0];
+    }
+    for (int c = 0; c < 3; c++) rgb[c] = count ? (float)sums[c] / (255.0f * (float)count) : 0.0f;
+}
+
+bool readImageSize(const std::string& path, int& width, int& height, int& channels) {
+    return stbi_info(path.c_str(), &width, &height, &channels) != 0;
+}
+
+static float lanczos(float x) {
+    x = fabsf(x);
+    if (x < 1e-6f) return 1.0f;
+    if (x >= (float)LANCZOS_RADIUS) return 0.0f;
+    const float pi = 3.14159265358979f;
+    float px = pi * x;
+    return (float)LANCZOS_RADIUS * sinf(px) * sinf(px / LANCZOS_RADIUS) / (px * px);
+}
+
+// Per output sample: first source index and normalized weights, padded to a
+// common tap count so the inner loops have a fixed trip count.
+struct ResampleFilter {
+    std::vector<int> starts;
+    std::vector<float> weights;
+    int taps;
+};
+
+static ResampleFilter buildFilter(int srcSize, int dstSize) {
+    ResampleFilter filter;
+    float scale = (float)srcSize / (float)dstSize;
+    float filterScale = scale > 1.0f ? scale : 1.0f;
+    float support = LANCZOS_RADIUS * filterScale;
+    filter.taps = (int)ceilf(support) * 2 + 1;
+    filter.starts.resize(dstSize);
+    filter.weights.assign((size_t)dstSize * filter.taps, 0.0f);
+
+    for (int i = 0; i < dstSize; i++) {
+        float center = (i + 0.5f) * scale;
+        int start = (int)floorf(center - support);
+        if (start < 0) start = 0;
+        if (start + filter.taps > srcSize) start = srcSize - filter.taps;
+        if (start < 0) start = 0;
+
+        float* w = &filter.weights[(size_t)i * filter.taps];
+        float sum = 0.0f;
+        for (int t = 0; t < filter.taps && start + t < srcSize; t++) {
+            w[t] = lanczos((start + t + 0.5f - center) / filterScale);
+            sum += w[t];
+        }
+        if (sum != 0.0f) {
+            for (int t = 0; t < filter.taps; t++) w[t] /= sum;
+        }
+        filter.starts[i] = start;
+    }
+    return filter;
+}
+
+#ifdef TEXTURE_IMPORT_SSE2
+static inline __m128 loadPixel(const unsigned char* p, int channels) {
+    uint32_t packed = 0;
+    memcpy(&packed, p, channels);
+    __m128i bytes = _mm_cvtsi32_si128((int)packed);
+    __m128i zero = _mm_setzero_si128();
+    __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+}
+
+static inline void storePixel(unsigned char* p, __m128 value, int channels) {
+    __m128i ints = _mm_cvtps_epi32(value);
+    __m128i words = _mm_packs_epi32(ints, ints);
+    __m128i bytes = _mm_packus_epi16(words, words);
+    uint32_t packed = (uint32_t)_mm_cvtsi128_si32(bytes);
+    memcpy(p, &packed, channels);
+}
+#endif
+
+void resampleImage(const unsigned char* src, int srcWidth, int srcHeight, int channels,
+                   unsigned char* dst, int dstWidth, int dstHeight) {
+    ResampleFilter horizontal = buildFilter(srcWidth, dstWidth);
+    ResampleFilter vertical = buildFilter(srcHeight, dstHeight);
+
+    // Horizontal pass into a float RGBA intermediate (srcHeight x dstWidth).
+    std::vector<float> tmp((size_t)srcHeight * dstWidth * 4);
+
+    for (int y = 0; y < srcHeight; y++) {
+        const unsigned char* row = src + (size_t)y * srcWidth * channels;
+        float* out = &tmp[(size_t)y * dstWidth * 4];
+        for (int x = 0; x < dstWidth; x++) {
+            const float* w = &horizontal.weights[(size_t)x * horizontal.taps];
+            const unsigned char* p = row + (size_t)horizontal.starts[x] * channels;
+            int taps = std::min(horizontal.taps, srcWidth - horizontal.starts[x]);
+#ifdef TEXTURE_IMPORT_SSE2
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < taps; t++) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[t]), loadPixel(p + t * channels, channels)));
+            }
+            _mm_storeu_ps(out + x * 4, acc);
+#else
+            float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int t = 0; t < taps; t++) {
+                for (int c = 0; c < channels; c++) acc[c] += w[t] * p[t * channels + c];
+            }
+            memcpy(out + x * 4, acc, sizeof(acc));
+#endif
+        }
+    }
+
+    // Vertical pass straight into the 8-bit destination.
+    for (int y = 0; y < dstHeight; y++) {
+        const float* w = &vertical.weights[(size_t)y * vertical.taps];
+        int start = vertical.starts[y];
+        int taps = std::min(vertical.taps, srcHeight - start);
+        unsigned char* out = dst + (size_t)y * dstWidth * channels;
+        for (int x = 0; x < dstWidth; x++) {
+#ifdef TEXTURE_IMPORT_SSE2
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < taps; t++) {
+                __m128 texel = _mm_loadu_ps(&tmp[((size_t)(start + t) * dstWidth + x) * 4]);
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[t]), texel));
+            }
+            storePixel(out + x * channels, acc, channels);
+#else
+            float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int t = 0; t < taps; t++) {
+                const float* texel = &tmp[((size_t)(start + t) * dstWidth + x) * 4];
+                for (int c = 0; c < channels; c++) acc[c] += w[t] * texel[c];
+            }
+            for (int c = 0; c < channels; c++) {
+                float v = floorf(acc[c] + 0.5f);
+                out[x * channels + c] = (unsigned char)(v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v));
+            }
+#endif
+        }
+    }
+}
+
+static uint64_t hashString(const std::string& s) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string cachePath(const std::string& path, int maxDimension) {
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx_%d.bin", (unsigned long long)hashString(path), maxDimension);
+    return std::string(TEXTURE_CACHE_DIR) + "/" + name;
+}
+
+static bool readCache(const std::string& file, uint64_t sourceSize, int64_t sourceTime, ImportedImage& out) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    TextureCacheHeader header;
+    if (!in.read((char*)&header, sizeof(header))) return false;
+    if (header.magic != TEXTURE_CACHE_MAGIC || header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        return false;
+    }
+
+    out.width = header.width;
+    out.height = header.height;
+    out.channels = header.channels;
+    out.sourceWidth = header.sourceWidth;
+    out.sourceHeight = header.sourceHeight;
+    out.pixels.resize((size_t)out.width * out.height * out.channels);
+    return (bool)in.read((char*)out.pixels.data(), out.pixels.size());
+}
+
+static void writeCache(const std::string& file, uint64_t sourceSize, int64_t sourceTime, const ImportedImage& image) {
+    std::error_code ec;
+    fs::create_directories(TEXTURE_CACHE_DIR, ec);
+
+    std::ofstream outFile(file, std::ios::binary);
+    if (!outFile.is_open()) return;
+
+    TextureCacheHeader header;
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.sourceWidth = image.sourceWidth;
+    header.sourceHeight = image.sourceHeight;
+    header.width = image.width;
+    header.height = image.height;
+    header.channels = image.channels;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    outFile.write((const char*)&header, sizeof(header));
+    outFile.write((const char*)image.pixels.data(), image.pixels.size());
+}
+
+bool importImage(const std::string& path, int maxDimension, ImportedImage& out) {
+    std::string cacheFile;
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (maxDimension > 0) {
+        std::error_code ec;
+        sourceSize = (uint64_t)fs::file_size(path, ec);
+        sourceTime = (int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+        cacheFile = cachePath(path, maxDimension);
+        if (readCache(cacheFile, sourceSize, sourceTime, out)) return true;
+    }
+
+    int width, height, channels;
+    unsigned char* pixels = loadImagePixels(path.c_str(), &width, &height, &channels);
+    if (!pixels) return false;
+
+    out.sourceWidth = width;
+    out.sourceHeight = height;
+    out.channels = channels;
+
+    if (maxDimension <= 0 || (width <= maxDimension && height <= maxDimension)) {
+        out.width = width;
+        out.height = height;
+        out.pixels.assign(pixels, pixels + (size_t)width * height * channels);
+        freeImagePixels(pixels);
+        return true;
+    }
+
+    float scale = (float)maxDimension / (float)std::max(width, height);
+    out.width = std::max(1, (int)floorf(width * scale + 0.5f));
+    out.height = std::max(1, (int)floorf(height * scale + 0.5f));
+    out.pixels.resize((size_t)out.width * out.height * channels);
+    resampleImage(pixels, width, height, channels, out.pixels.data(), out.width, out.height);
+    freeImagePixels(pixels);
+
+    writeCache(cacheFile, sourceSize, sourceTime, out);
+    return true;
+}
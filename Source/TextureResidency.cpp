@@ -0,0 +1,366 @@
+#include "../Header/TextureResidency.h"
+#include "../Header/Util.h"
+#include "../Header/Profiler.h"
+#include "../Header/TextureImport.h"
+#include "../Header/GLState.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+const int MAX_RESTREAMS_PER_FRAME = 2;
+const unsigned long long EVICTION_GRACE_FRAMES = 2;
+const unsigned long long RESTREAM_RETRY_FRAMES = 60;
+
+TextureResidency::TextureResidency(size_t budgetBytes) : frame(0) {
+    stats.budgetBytes = budgetBytes;
+    stats.residentBytes = 0;
+    stats.evictions = 0;
+    stats.restreams = 0;
+}
+
+GLuint TextureResidency::create(const ImportedImage& image, bool mipmapped, GLint wrapMode, Entry& entry) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glState.bindTexture(0, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+
+    entry.target = GL_TEXTURE_2D;
+    entry.fullWidth = image.width;
+    entry.fullHeight = image.height;
+    entry.channels = image.channels;
+    entry.droppedMips = 0;
+    entry.layers = 0;
+    entry.mipmapped = mipmapped;
+    entry.bytes = 0;
+    entry.lastUsedFrame = frame;
+    entry.nextRestreamFrame = 0;
+    entry.restreamRequested = false;
+    upload(entry, image.pixels.data(), image.width, image.height);
+
+    stats.residentBytes += entry.bytes;
+    return texture;
+}
+
+GLuint TextureResidency::load(const std::string& path, GLint wrapMode, int maxDimension, TextureLoadInfo* info) {
+    ImportedImage image;
+    if (!importImage(path, maxDimension, image)) {
+        std::cout << "Textura nije ucitana! Putanja texture: " << path << std::endl;
+        return 0;
+    }
+
+    Entry entry;
+    GLuint texture = create(image, true, wrapMode, entry);
+    if (info) {
+        info->sourceWidth = image.sourceWidth;
+        info->sourceHeight = image.sourceHeight;
+        info->width = image.width;
+        info->height = image.height;
+        info->channels = image.channels;
+        imageAverageColor(image.pixels.data(), image.width, image.height, image.channels, info->averageColor);
+    }
+    entry.pixels = std::move(image.pixels);
+    entries[texture] = std::move(entry);
+
+    while (stats.residentBytes > stats.budgetBytes && evictLeastRecentlyUsed(texture)) {}
+    publishStats();
+    return texture;
+}
+
+GLuint TextureResidency::loadOverlay(const std::string& path) {
+    ImportedImage image;
+    if (!importImage(path, 0, image)) {
+        std::cout << "Textura nije ucitana! Putanja texture: " << path << std::endl;
+        return 0;
+    }
+
+    Entry entry;
+    GLuint texture = create(image, false, GL_REPEAT, entry);
+    entries[texture] = std::move(entry);
+
+    while (stats.residentBytes > stats.budgetBytes && evictLeastRecentlyUsed(texture)) {}
+    publishStats();
+    return texture;
+}
+
+static void expandToRGBA(const ImportedImage& image, std::vector<unsigned char>& out) {
+    size_t count = (size_t)image.width * image.height;
+    out.resize(count * 4);
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* src = &image.pixels[i * image.channels];
+        unsigned char* dst = &out[i * 4];
+        if (image.channels >= 3) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        } else {
+            dst[0] = dst[1] = dst[2] = src[0];
+        }
+        dst[3] = image.channels == 4 ? src[3] : (image.channels == 2 ? src[1] : 255);
+    }
+}
+
+std::vector<GLuint> TextureResidency::loadArrays(const std::vector<std::string>& paths,
+                                                 const std::vector<int>& maxDimensions, GLint wrapMode,
+                                                 TextureArrayInfo* info) {
+    std::vector<ImportedImage> images;
+    std::vector<int> imageOfPath(paths.size(), -1);
+    size_t sourceBytes = 0;
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        ImportedImage image;
+        int maxDimension = i < maxDimensions.size() ? maxDimensions[i] : 0;
+        if (!importImage(paths[i], maxDimension, image)) {
+            std::cout << "Textura nije ucitana! Putanja texture: " << paths[i] << std::endl;
+            continue;
+        }
+        sourceBytes += textureMipChainBytes(image.sourceWidth, image.sourceHeight, image.channels);
+        imageOfPath[i] = (int)images.size();
+        images.push_back(std::move(image));
+    }
+
+    // One array per distinct size, in order of first appearance.
+    std::vector<int> imageArray(images.size()), imageLayer(images.size());
+    std::vector<int> widths, heights;
+    std::vector<std::vector<unsigned char>> arrayPixels;
+    std::vector<unsigned char> rgba;
+    for (size_t i = 0; i < images.size(); i++) {
+        const ImportedImage& image = images[i];
+        int array = 0;
+        while (array < (int)widths.size() && (widths[array] != image.width || heights[array] != image.height)) array++;
+        if (array == (int)widths.size()) {
+            widths.push_back(image.width);
+            heights.push_back(image.height);
+            arrayPixels.emplace_back();
+        }
+        size_t layerBytes = (size_t)image.width * image.height * 4;
+        imageArray[i] = array;
+        imageLayer[i] = (int)(arrayPixels[array].size() / layerBytes);
+        expandToRGBA(image, rgba);
+        arrayPixels[array].insert(arrayPixels[array].end(), rgba.begin(), rgba.end());
+    }
+    std::vector<ImportedImage>().swap(images);
+
+    std::vector<GLuint> textures;
+    size_t importedBytes = 0;
+    for (size_t array = 0; array < arrayPixels.size(); array++) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glState.bindTexture(0, texture, GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapMode);
+
+        Entry entry;
+        entry.target = GL_TEXTURE_2D_ARRAY;
+        entry.fullWidth = widths[array];
+        entry.fullHeight = heights[array];
+        entry.channels = 4;
+        entry.droppedMips = 0;
+        entry.layers = (int)(arrayPixels[array].size() / ((size_t)widths[array] * heights[array] * 4));
+        entry.mipmapped = true;
+        entry.bytes = 0;
+        entry.lastUsedFrame = frame;
+        entry.nextRestreamFrame = 0;
+        entry.restreamRequested = false;
+        upload(entry, arrayPixels[array].data(), entry.fullWidth, entry.fullHeight);
+        entry.pixels = std::move(arrayPixels[array]);
+
+        stats.residentBytes += entry.bytes;
+        importedBytes += entry.bytes;
+        entries[texture] = std::move(entry);
+        textures.push_back(texture);
+    }
+
+    if (info) {
+        info->arrays.assign(paths.size(), -1);
+        info->layers.assign(paths.size(), -1);
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (imageOfPath[i] < 0) continue;
+            info->arrays[i] = imageArray[imageOfPath[i]];
+            info->layers[i] = imageLayer[imageOfPath[i]];
+        }
+        info->widths = widths;
+        info->heights = heights;
+        info->sourceBytes = sourceBytes;
+        info->importedBytes = importedBytes;
+    }
+
+    // The new arrays are inside the eviction grace period, so only older textures give way.
+    while (stats.residentBytes > stats.budgetBytes && evictLeastRecentlyUsed(0)) {}
+    publishStats();
+    return textures;
+}
+
+// Arrays take one layer after another from pixels.
+void TextureResidency::upload(Entry& entry, const unsigned char* pixels, int width, int height) {
+    GLenum format = textureFormatForChannels(entry.channels);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (entry.layers > 0) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, entry.layers, 0, format, GL_UNSIGNED_BYTE,
+                     pixels);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    }
+    if (entry.mipmapped) glGenerateMipmap(entry.target);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    entry.width = width;
+    entry.height = height;
+    size_t layerBytes = entry.mipmapped ? textureMipChainBytes(width, height, entry.channels)
+                                        : (size_t)width * height * entry.channels;
+    entry.bytes = layerBytes * std::max(entry.layers, 1);
+}
+
+void TextureResidency::touch(GLuint texture) {
+    auto it = entries.find(texture);
+    if (it == entries.end()) return;
+    Entry& entry = it->second;
+    entry.lastUsedFrame = frame;
+    if (entry.droppedMips > 0 && frame >= entry.nextRestreamFrame) entry.restreamRequested = true;
+}
+
+void TextureResidency::beginFrame() {
+    frame++;
+
+    int restreamed = 0;
+    for (auto& pair : entries) {
+        if (restreamed >= MAX_RESTREAMS_PER_FRAME) break;
+        if (!pair.second.restreamRequested) continue;
+        if (restream(pair.first, pair.second)) restreamed++;
+    }
+
+    while (stats.residentBytes > stats.budgetBytes && evictLeastRecentlyUsed(0)) {}
+    publishStats();
+}
+
+// 2x2 box filter; odd edges repeat their last row or column.
+static void halveImage(const unsigned char* src, int width, int height, int channels,
+                       std::vector<unsigned char>& dst, int& outWidth, int& outHeight) {
+    outWidth = width > 1 ? width / 2 : 1;
+    outHeight = height > 1 ? height / 2 : 1;
+    dst.resize((size_t)outWidth * outHeight * channels);
+    for (int y = 0; y < outHeight; y++) {
+        int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < outWidth; x++) {
+            int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < channels; c++) {
+                int sum = src[((size_t)y0 * width + x0) * channels + c] + src[((size_t)y0 * width + x1) * channels + c] +
+                          src[((size_t)y1 * width + x0) * channels + c] + src[((size_t)y1 * width + x1) * channels + c];
+                dst[((size_t)y * outWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool TextureResidency::dropTopMip(GLuint texture, Entry& entry) {
+    if (entry.width <= 1 && entry.height <= 1) return false;
+
+    // Rebuilt from the kept level 0; the GPU copy is never read back.
+    int layerCount = std::max(entry.layers, 1);
+    size_t layerBytes = (size_t)entry.fullWidth * entry.fullHeight * entry.channels;
+    std::vector<unsigned char> levels, level, next;
+    int width = entry.fullWidth, height = entry.fullHeight;
+    for (int layer = 0; layer < layerCount; layer++) {
+        const unsigned char* src = entry.pixels.data() + layer * layerBytes;
+        level.assign(src, src + layerBytes);
+        width = entry.fullWidth;
+        height = entry.fullHeight;
+        for (int i = 0; i <= entry.droppedMips; i++) {
+            halveImage(level.data(), width, height, entry.channels, next, width, height);
+            level.swap(next);
+        }
+        levels.insert(levels.end(), level.begin(), level.end());
+    }
+
+    size_t oldBytes = entry.bytes;
+    glState.bindTexture(0, texture, entry.target);
+    upload(entry, levels.data(), width, height);
+
+    stats.residentBytes = stats.residentBytes - oldBytes + entry.bytes;
+    entry.droppedMips++;
+    stats.evictions++;
+    return true;
+}
+
+bool TextureResidency::restream(GLuint texture, Entry& entry) {
+    entry.restreamRequested = false;
+    size_t fullBytes = textureMipChainBytes(entry.fullWidth, entry.fullHeight, entry.channels) *
+                       std::max(entry.layers, 1);
+    while (stats.residentBytes - entry.bytes + fullBytes > stats.budgetBytes) {
+        if (!evictLeastRecentlyUsed(texture)) {
+            // No room yet; try again once other textures have aged.
+            entry.nextRestreamFrame = frame + RESTREAM_RETRY_FRAMES;
+            return false;
+        }
+    }
+
+    size_t oldBytes = entry.bytes;
+    glState.bindTexture(0, texture, entry.target);
+    upload(entry, entry.pixels.data(), entry.fullWidth, entry.fullHeight);
+
+    stats.residentBytes = stats.residentBytes - oldBytes + entry.bytes;
+    entry.droppedMips = 0;
+    stats.restreams++;
+    return true;
+}
+
+bool TextureResidency::evictLeastRecentlyUsed(GLuint keep) {
+    GLuint victim = 0;
+    Entry* victimEntry = nullptr;
+    for (auto& pair : entries) {
+        Entry& e = pair.second;
+        if (pair.first == keep) continue;
+        if (!e.mipmapped) continue;
+        if (e.width <= 1 && e.height <= 1) continue;
+        if (e.lastUsedFrame + EVICTION_GRACE_FRAMES > frame) continue;
+        if (!victimEntry || e.lastUsedFrame < victimEntry->lastUsedFrame ||
+            (e.lastUsedFrame == victimEntry->lastUsedFrame && e.bytes > victimEntry->bytes)) {
+            victim = pair.first;
+            victimEntry = &e;
+        }
+    }
+    if (!victimEntry) return false;
+    return dropTopMip(victim, *victimEntry);
+}
+
+void TextureResidency::release(GLuint texture) {
+    if (!texture) return;
+    auto it = entries.find(texture);
+    if (it != entries.end()) {
+        stats.residentBytes -= it->second.bytes;
+        entries.erase(it);
+        publishStats();
+    }
+    glState.forgetTexture(texture);
+    glDeleteTextures(1, &texture);
+}
+
+void TextureResidency::releaseAll() {
+    for (auto& pair : entries) {
+        GLuint texture = pair.first;
+        glState.forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+    entries.clear();
+    stats.residentBytes = 0;
+    publishStats();
+}
+
+void TextureResidency::setBudget(size_t bytes) {
+    stats.budgetBytes = bytes;
+    while (stats.residentBytes > stats.budgetBytes && evictLeastRecentlyUsed(0)) {}
+    publishStats();
+}
+
+void TextureResidency::publishStats() {
+    profilerSet(PROF_TEXTURE_BUDGET_BYTES, (long long)stats.budgetBytes);
+    profilerSet(PROF_TEXTURE_RESIDENT_BYTES, (long long)stats.residentBytes);
+    profilerSet(PROF_TEXTURE_EVICTIONS, (long long)stats.evictions);
+    profilerSet(PROF_TEXTURE_RESTREAMS, (long long)stats.restreams);
+}
@@ -4,19 +4,72 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <ctime>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../Header/stb_image.h"
 
+const char* const SHADER_CACHE_DIR = "Cache/shaders";
+const uint32_t SHADER_CACHE_MAGIC = 0x31485353; // "SSH1"
+
 int endProgram(std::string message) {
     std::cout << message << std::endl;
     glfwTerminate();
     return -1;
 }
 
-unsigned int compileShader(GLenum type, const char* source)
+double processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) * 1.0e-7;
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) return 0.0;
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+#endif
+}
+
+void preciseSleepUntil(double deadline) {
+    const double SPIN_MARGIN = 0.002;
+    double remaining = deadline - glfwGetTime();
+    if (remaining > SPIN_MARGIN) {
+#ifdef _WIN32
+        // The default timer resolution rounds every sleep up to ~15.6 ms; raise
+        // it only while sleeping, since it is a system-wide setting.
+        timeBeginPeriod(1);
+#endif
+        std::this_thread::sleep_for(std::chrono::duration<double>(remaining - SPIN_MARGIN));
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+    while (glfwGetTime() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+static std::string readShaderSource(const char* source)
 {
-    std::string content = "";
     std::ifstream file(source);
     std::stringstream ss;
     if (file.is_open())
@@ -29,8 +82,12 @@ unsigned int compileShader(GLenum type, const char* source)
         ss << "";
         std::cout << "Greska pri citanju fajla sa putanje \"" << source << "\"!" << std::endl;
     }
-    std::string temp = ss.str();
-    const char* sourceCode = temp.c_str();
+    return ss.str();
+}
+
+unsigned int compileShader(GLenum type, const std::string& source)
+{
+    const char* sourceCode = source.c_str();
 
     int shader = glCreateShader(type);
 
@@ -52,16 +109,149 @@ unsigned int compileShader(GLenum type, const char* source)
     }
     return shader;
 }
+
+// Linked programs are cached in Cache/shaders as driver binaries, keyed by a hash
+// of both sources and the GL vendor/renderer/version strings. The header stores
+// how long the original compile and link took so a cache hit can report the
+// time it saved.
+struct ShaderCacheHeader {
+    uint32_t magic;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+    float compileMs;
+};
+
+static bool programBinarySupported()
+{
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+static std::string shaderCachePath(const std::string& vsCode, const std::string& fsCode)
+{
+    std::string key = vsCode + '\0' + fsCode + '\0';
+    const char* strings[] = {
+        (const char*)glGetString(GL_VENDOR),
+        (const char*)glGetString(GL_RENDERER),
+        (const char*)glGetString(GL_VERSION)
+    };
+    for (const char* str : strings) {
+        if (str) key += str;
+        key += '\0';
+    }
+
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return std::string(SHADER_CACHE_DIR) + "/" + name;
+}
+
+static unsigned int loadCachedProgram(const std::string& cacheFile, float& savedMs)
+{
+    std::ifstream in(cacheFile, std::ios::binary);
+    if (!in.is_open()) return 0;
+
+    ShaderCacheHeader header;
+    if (!in.read((char*)&header, sizeof(header)) || header.magic != SHADER_CACHE_MAGIC) return 0;
+    std::vector<char> binary(header.binaryLength);
+    if (!in.read(binary.data(), binary.size())) return 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success == GL_FALSE)
+    {
+        std::cout << "Binarni sejder odbijen, ponovo kompajliram (\"" << cacheFile << "\")." << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    float loadMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    savedMs = header.compileMs - loadMs;
+    return program;
+}
+
+static void storeCachedProgram(const std::string& cacheFile, unsigned int program, float compileMs)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+
+    std::error_code ec;
+    std::filesystem::create_directories(SHADER_CACHE_DIR, ec);
+    std::ofstream out(cacheFile, std::ios::binary);
+    if (!out.is_open()) return;
+
+    ShaderCacheHeader header;
+    header.magic = SHADER_CACHE_MAGIC;
+    header.binaryFormat = format;
+    header.binaryLength = (uint32_t)length;
+    header.compileMs = compileMs;
+    out.write((const char*)&header, sizeof(header));
+    out.write(binary.data(), binary.size());
+}
+
+static std::string injectDefines(const std::string& code, const std::string& defines)
+{
+    if (defines.empty()) return code;
+    size_t versionLine = code.find("#version");
+    if (versionLine == std::string::npos) return defines + code;
+    size_t lineEnd = code.find('\n', versionLine);
+    if (lineEnd == std::string::npos) return code + "\n" + defines;
+    return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+}
+
 unsigned int createShader(const char* vsSource, const char* fsSource)
 {
+    return createShaderVariant(vsSource, fsSource, "");
+}
+
+unsigned int createShaderVariant(const char* vsSource, const char* fsSource, const std::string& defines)
+{
+    std::string vsCode = injectDefines(readShaderSource(vsSource), defines);
+    std::string fsCode = injectDefines(readShaderSource(fsSource), defines);
+
+    bool useCache = programBinarySupported();
+    std::string cacheFile;
+    if (useCache)
+    {
+        cacheFile = shaderCachePath(vsCode, fsCode);
+        float savedMs = 0.0f;
+        unsigned int cached = loadCachedProgram(cacheFile, savedMs);
+        if (cached)
+        {
+            std::cout << "Sejder \"" << vsSource << "\" + \"" << fsSource << "\" ucitan iz kesa, ustedjeno "
+                      << savedMs << " ms." << std::endl;
+            return cached;
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
     unsigned int program;
     unsigned int vertexShader;
     unsigned int fragmentShader;
 
     program = glCreateProgram();
+    if (useCache)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-    vertexShader = compileShader(GL_VERTEX_SHADER, vsSource);
-    fragmentShader = compileShader(GL_FRAGMENT_SHADER, fsSource);
+    vertexShader = compileShader(GL_VERTEX_SHADER, vsCode);
+    fragmentShader = compileShader(GL_FRAGMENT_SHADER, fsCode);
 
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
@@ -84,9 +274,40 @@ unsigned int createShader(const char* vsSource, const char* fsSource)
     glDetachShader(program, fragmentShader);
     glDeleteShader(fragmentShader);
 
+    float compileMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (useCache && success == GL_TRUE)
+    {
+        storeCachedProgram(cacheFile, program, compileMs);
+        std::cout << "Sejder \"" << vsSource << "\" + \"" << fsSource << "\" kompajliran za "
+                  << compileMs << " ms i sacuvan u kes." << std::endl;
+    }
+
     return program;
 }
 
+GLenum textureFormatForChannels(int channels) {
+    switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    case 4: return GL_RGBA;
+    default: return GL_RGB;
+    }
+}
+
+unsigned char* loadImagePixels(const char* filePath, int* width, int* height, int* channels) {
+    unsigned char* pixels = stbi_load(filePath, width, height, channels, 0);
+    if (pixels != NULL) {
+        stbi__vertical_flip(pixels, *width, *height, *channels);
+    }
+    return pixels;
+}
+
+void freeImagePixels(unsigned char* pixels) {
+    stbi_image_free(pixels);
+}
+
 unsigned loadImageToTexture(const char* filePath) {
     int TextureWidth;
     int TextureHeight;
@@ -96,14 +317,7 @@ unsigned loadImageToTexture(const char* filePath) {
     {
         stbi__vertical_flip(ImageData, TextureWidth, TextureHeight, TextureChannels);
 
-        GLint InternalFormat = -1;
-        switch (TextureChannels) {
-        case 1: InternalFormat = GL_RED; break;
-        case 2: InternalFormat = GL_RG; break;
-        case 3: InternalFormat = GL_RGB; break;
-        case 4: InternalFormat = GL_RGBA; break;
-        default: InternalFormat = GL_RGB; break;
-        }
+        GLint InternalFormat = textureFormatForChannels(TextureChannels);
 
         unsigned int Texture;
         glGenTextures(1, &Texture);